@@ -6,17 +6,20 @@
 #include "util/file_piece.hh"
 #include "util/tokenize_piece.hh"
 
+#include <algorithm>
+
 namespace decode {
 
 Chart::Chart(std::size_t max_source_phrase_length,
     const BaseVocab &vocab,
     Objective &objective,
     VertexCache &cache)
-    : max_source_phrase_length_(max_source_phrase_length),
+    : vocab_map_(objective, vocab),
+      base_vocab_size_(vocab.Size()),
       objective_(objective),
       feature_init_(objective.GetFeatureInit()),
-      cache_(cache),
-      vocab_map_(objective, vocab) {
+      max_source_phrase_length_(max_source_phrase_length),
+      cache_(cache) {
   UTIL_THROW_IF(objective.GetLanguageModelFeature() == nullptr, util::Exception,
       "Missing language model for objective!");
   pt::Access access = feature_init_.phrase_access;
@@ -28,6 +31,12 @@ Chart::Chart(std::size_t max_source_phrase_length,
   objective_.InitPassthroughPhrase(eos_phrase_, TargetPhraseType::EOS);
 }
 
+Chart::~Chart() {
+  for (std::vector<VertexCache::Entry*>::const_iterator i = acquired_.begin(); i != acquired_.end(); ++i) {
+    cache_.Release(**i);
+  }
+}
+
 void Chart::ReadSentence(StringPiece input) {
   for (util::TokenIter<util::BoolCharacter, true> word(input, util::kSpaces); word; ++word) {
     ID id; // set by VocabMap
@@ -40,8 +49,7 @@ void Chart::AddTargetPhraseToVertex(
     const pt::Row *phrase,
     search::Vertex &vertex,
     TargetPhraseType type,
-    bool use_cache) {
-  util::Pool &phrase_pool = use_cache ? cache_.target_phrase_pool : target_phrase_pool_;
+    util::Pool &phrase_pool) {
   TargetPhrase *phrase_wrapper = reinterpret_cast<TargetPhrase*>(
       feature_init_.target_phrase_layout.Allocate(phrase_pool));
   feature_init_.pt_row_field(phrase_wrapper) = phrase;
@@ -53,12 +61,49 @@ void Chart::AddTargetPhraseToVertex(
   feature_init_.phrase_score_field(phrase_wrapper) = score;
   hypo.score = score;
   hypo.history.cvp = phrase_wrapper;
-  vertex.Root().AppendHypothesis(hypo);
+  vertex.AppendHypothesis(hypo);
+}
+
+void Chart::AddTargetPhrasesToVertex(
+    const std::vector<const pt::Row*> &phrases,
+    search::Vertex &vertex,
+    util::Pool &phrase_pool) {
+  // TargetPhraseInfo refers to the wrapper pointers, so they must not move.
+  std::vector<TargetPhrase*> wrappers(phrases.size());
+  std::vector<TargetPhraseInfo> targets;
+  targets.reserve(phrases.size());
+  for (std::size_t i = 0; i < phrases.size(); ++i) {
+    wrappers[i] = reinterpret_cast<TargetPhrase*>(feature_init_.target_phrase_layout.Allocate(phrase_pool));
+    feature_init_.pt_row_field(wrappers[i]) = phrases[i];
+    targets.push_back(TargetPhraseInfo{wrappers[i], vocab_map_, phrase_pool, TargetPhraseType::Table});
+  }
+  std::vector<lm::ngram::ChartState> states;
+  objective_.GetLanguageModelFeature()->InitTargetPhrases(targets, states);
+  for (std::size_t i = 0; i < phrases.size(); ++i) {
+    search::HypoState hypo;
+    hypo.state = states[i];
+    float score = objective_.ScoreTargetPhrase(targets[i]);
+    feature_init_.phrase_score_field(wrappers[i]) = score;
+    hypo.score = score;
+    hypo.history.cvp = wrappers[i];
+    vertex.AppendHypothesis(hypo);
+  }
+}
+
+VertexCache::Entry *Chart::AcquireCached(std::size_t begin, std::size_t end) {
+  // Ids of unknown words are only meaningful within this sentence.
+  for (std::size_t i = begin; i != end; ++i) {
+    if (sentence_ids_[i] >= base_vocab_size_) return NULL;
+  }
+  VertexCache::Entry *entry = cache_.Acquire(&sentence_ids_[begin], &*sentence_ids_.begin() + end);
+  if (entry) acquired_.push_back(entry);
+  return entry;
 }
 
 void Chart::AddPassthrough(std::size_t position) {
   TargetPhrases *pass = vertex_pool_.construct();
-  pass->Root().InitRoot();
+  vertices_.push_back(pass);
+  pass->InitRoot();
   pt::Access access = feature_init_.phrase_access;
   pt::Row* pt_phrase = access.Allocate(passthrough_pool_);
   if (access.target) {
@@ -66,16 +111,61 @@ void Chart::AddPassthrough(std::size_t position) {
     access.target(pt_phrase)[0] = sentence_ids_[position];
   }
   objective_.InitPassthroughPhrase(pt_phrase, TargetPhraseType::Passthrough);
-  AddTargetPhraseToVertex(pt_phrase, *pass, TargetPhraseType::Passthrough, false);
-  pass->Root().FinishRoot(search::kPolicyLeft);
+  AddTargetPhraseToVertex(pt_phrase, *pass, TargetPhraseType::Passthrough, target_phrase_pool_);
+  pass->FinishRoot(search::kPolicyLeft);
   SetRange(position, position+1, pass);
+  passthroughs_.push_back(pass);
+}
+
+void Chart::RescoreVertex(search::Vertex &vertex, TargetPhraseType type) {
+  std::vector<search::HypoState> &hypos = vertex.ReopenRoot();
+  for (std::vector<search::HypoState>::iterator hypo = hypos.begin(); hypo != hypos.end(); ++hypo) {
+    TargetPhrase *phrase = reinterpret_cast<TargetPhrase*>(hypo->history.cvp);
+    TargetPhraseInfo target{phrase, vocab_map_, target_phrase_pool_, type};
+    hypo->score = objective_.ScoreTargetPhrase(target);
+    feature_init_.phrase_score_field(phrase) = hypo->score;
+  }
+  vertex.FinishRoot(search::kPolicyLeft);
+}
+
+void Chart::Rescore() {
+  // Vertices shared between spans are rescored more than once, which is harmless.
+  for (std::vector<TargetPhrases*>::iterator i = entries_.begin(); i != entries_.end(); ++i) {
+    if (!*i) continue;
+    bool passthrough = std::find(passthroughs_.begin(), passthroughs_.end(), *i) != passthroughs_.end();
+    RescoreVertex(**i, passthrough ? TargetPhraseType::Passthrough : TargetPhraseType::Table);
+  }
+}
+
+namespace {
+void AddVertices(const std::vector<search::Vertex*> &vertices, std::size_t &objects, std::size_t &contents) {
+  objects += vertices.size() * sizeof(search::Vertex);
+  for (std::vector<search::Vertex*>::const_iterator i = vertices.begin(); i != vertices.end(); ++i) {
+    contents += (*i)->MemoryBytes();
+  }
+}
+} // namespace
+
+void Chart::ReportMemory(util::PoolReport &report) const {
+  report.Add("chart/target_phrases", target_phrase_pool_);
+  report.Add("chart/passthrough", passthrough_pool_);
+  std::size_t objects = 0, contents = 0;
+  AddVertices(vertices_, objects, contents);
+  for (boost::ptr_vector<WorkerAllocators>::const_iterator i = worker_allocators_.begin(); i != worker_allocators_.end(); ++i) {
+    report.Add("chart/target_phrases", i->target_phrase_pool);
+    AddVertices(i->vertices, objects, contents);
+  }
+  report.AddBytes("chart/vertices", objects);
+  report.AddBytes("chart/vertex_hypotheses", contents);
+  report.AddBytes("chart/entries", entries_.capacity() * sizeof(TargetPhrases*));
 }
 
 TargetPhrases &Chart::EndOfSentence() {
   search::Vertex &eos = *vertex_pool_.construct();
-  eos.Root().InitRoot();
-  AddTargetPhraseToVertex(eos_phrase_, eos, TargetPhraseType::EOS, false);
-  eos.Root().FinishRoot(search::kPolicyLeft);
+  vertices_.push_back(&eos);
+  eos.InitRoot();
+  AddTargetPhraseToVertex(eos_phrase_, eos, TargetPhraseType::EOS, target_phrase_pool_);
+  eos.FinishRoot(search::kPolicyLeft);
   return eos;
 }
 
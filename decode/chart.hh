@@ -2,15 +2,20 @@
 #define DECODE_CHART__
 
 #include "decode/source_phrase.hh"
+#include "decode/vertex_cache.hh"
 #include "decode/vocab_map.hh"
+#include "decode/workers.hh"
 #include "decode/types.hh"
 #include "pt/format.hh"
 #include "search/vertex.hh"
+#include "util/counter.hh"
 #include "util/pool.hh"
 #include "util/string_piece.hh"
 
 #include <boost/pool/object_pool.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
 #include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
 #include <boost/utility.hpp>
 
 #include <vector>
@@ -25,51 +30,73 @@ struct FeatureInit;
 
 typedef search::Vertex TargetPhrases;
 
-// TODO currently not thread-safe because of cache_!
+// Not thread-safe because of cache_: charts sharing a cache must load their
+// phrases one at a time.
 // Target phrases that correspond to each source span
 class Chart {
   public:
-    typedef boost::unordered_map<SourcePhrase,search::Vertex,SourcePhraseHasher,SourcePhraseEqual> VertexMap;
-    struct VertexCache {
-      VertexCache() {}
-      explicit VertexCache(std::size_t size) : map(size) {}
-      VertexMap map;
-      util::Pool target_phrase_pool;
-    };
+    typedef decode::VertexCache VertexCache;
 
     static constexpr ID EOS_WORD = 2;
 
     Chart(std::size_t max_source_phrase_length, const BaseVocab &vocab, Objective &objective, VertexCache &cache);
 
+    // Releases the cache entries this chart used.
+    ~Chart();
+
     void ReadSentence(StringPiece input);
 
-    template <class PhraseTable> void LoadPhrases(const PhraseTable &table) {
+    // Look up and score target phrases for every span.  With threads > 1,
+    // spans that need scoring are divided among that many of workers.  Each
+    // thread allocates from its own pools and every span is built the same
+    // way regardless, so the result does not depend on the thread count.
+    // If keep is not NULL, phrases of two or more words are only loaded if
+    // their rows are in keep, bypassing the vertex cache.  Every word keeps
+    // its one-word phrases, so any gap can still be covered, which future
+    // costs and search assume.
+    template <class PhraseTable> void LoadPhrases(const PhraseTable &table, Workers &workers, std::size_t threads, const RowSet *keep = NULL) {
       // There's some unreachable ranges off the edge. Meh.
       entries_.resize(sentence_.size() * max_source_phrase_length_);
+      // Consult the cache serially; it is not thread-safe.
+      std::vector<LoadTask> tasks;
+      // Repeated phrases share a cached vertex that is loaded once.
+      std::vector<LoadTask> repeats;
       for (std::size_t begin = 0; begin != sentence_.size(); ++begin) {
         for (std::size_t end = begin + 1; (end != sentence_.size() + 1) && (end <= begin + max_source_phrase_length_); ++end) {
-          SourcePhrase source_phrase(sentence_, begin, end);
-          search::Vertex *vertex;
-          bool use_cache = end - begin <= cached_phrase_max_length_;
-          if (use_cache) {
-            vertex = &cache_.map[source_phrase];
-            if (!vertex->Empty()) {
-              SetRange(begin, end, vertex);
+          LoadTask task;
+          task.begin = begin;
+          task.end = end;
+          task.entry = (keep && end - begin > 1) ? NULL : AcquireCached(begin, end);
+          if (task.entry) {
+            if (task.entry->Loaded()) {
+              UTIL_COUNT("chart/vertex_cache_hits");
+              if (!task.entry->vertex.Empty()) SetRange(begin, end, &task.entry->vertex);
               continue;
             }
-          } else {
-            vertex = vertex_pool_.construct();
-          }
-          auto phrases = table.Lookup(&sentence_ids_[begin], &*sentence_ids_.begin() + end);
-          if (phrases) {
-            vertex->Root().InitRoot();
-            for (auto phrase = phrases.begin(); phrase != phrases.end(); ++phrase) {
-              AddTargetPhraseToVertex(&*phrase, *vertex, TargetPhraseType::Table, use_cache);
+            if (!loading_.insert(task.entry).second) {
+              repeats.push_back(task);
+              continue;
             }
-            vertex->Root().FinishRoot(search::kPolicyLeft);
-            SetRange(begin, end, vertex);
           }
+          tasks.push_back(task);
         }
+      }
+
+      threads = std::max<std::size_t>(1, std::min(std::min(threads, workers.Threads()), tasks.size()));
+      // Create per-thread allocators up front so workers only read the lists.
+      while (worker_allocators_.size() < threads - 1) worker_allocators_.push_back(new WorkerAllocators());
+      workers.Run(threads, [&](std::size_t worker) {
+        LoadWorker(table, tasks, keep, worker, threads);
+      });
+
+      for (std::vector<LoadTask>::const_iterator i = repeats.begin(); i != repeats.end(); ++i) {
+        if (!i->entry->vertex.Empty()) SetRange(i->begin, i->end, &i->entry->vertex);
+      }
+      for (boost::unordered_set<VertexCache::Entry*>::const_iterator i = loading_.begin(); i != loading_.end(); ++i) {
+        cache_.Loaded(**i);
+      }
+      loading_.clear();
+      for (std::size_t begin = 0; begin != sentence_.size(); ++begin) {
         if (!Range(begin, begin + 1)) {
           AddPassthrough(begin);
         }
@@ -92,9 +119,64 @@ class Chart {
 
     TargetPhrases &EndOfSentence();
 
+    // Score the loaded target phrases again with the objective's current
+    // weights.  Their features are kept, so this is only a dot product.
+    void Rescore();
+
+    // Adds chart/* entries for memory held by this sentence.
+    void ReportMemory(util::PoolReport &report) const;
+
     const VocabMap &VocabMapping() const { return vocab_map_; }
 
   private:
+    struct LoadTask {
+      std::size_t begin, end;
+      // Cache entry to fill or NULL to allocate a vertex.
+      VertexCache::Entry *entry;
+    };
+
+    // Allocators for spans loaded by threads other than the caller.
+    struct WorkerAllocators {
+      boost::object_pool<search::Vertex> vertex_pool;
+      util::Pool target_phrase_pool;
+      // Vertices constructed in vertex_pool.
+      std::vector<search::Vertex*> vertices;
+    };
+
+    // Load every threads-th task starting with worker.  Worker 0 is the
+    // calling thread and uses the chart's own pools.
+    template <class PhraseTable> void LoadWorker(const PhraseTable &table, const std::vector<LoadTask> &tasks, const RowSet *keep, std::size_t worker, std::size_t threads) {
+      boost::object_pool<search::Vertex> &vertex_pool = worker ? worker_allocators_[worker - 1].vertex_pool : vertex_pool_;
+      util::Pool &phrase_pool = worker ? worker_allocators_[worker - 1].target_phrase_pool : target_phrase_pool_;
+      std::vector<search::Vertex*> &owned = worker ? worker_allocators_[worker - 1].vertices : vertices_;
+      std::vector<const pt::Row*> rows;
+      for (std::size_t t = worker; t < tasks.size(); t += threads) {
+        const LoadTask &task = tasks[t];
+        UTIL_COUNT("chart/lookups");
+        auto phrases = table.Lookup(&sentence_ids_[task.begin], &*sentence_ids_.begin() + task.end);
+        if (!phrases) continue;
+        UTIL_COUNT("chart/lookup_hits");
+        const RowSet *filter = (task.end - task.begin > 1) ? keep : NULL;
+        rows.clear();
+        for (auto phrase = phrases.begin(); phrase != phrases.end(); ++phrase) {
+          if (!filter || filter->count(&*phrase)) rows.push_back(&*phrase);
+        }
+        if (rows.empty()) continue;
+        search::Vertex *vertex;
+        if (task.entry) {
+          vertex = &task.entry->vertex;
+        } else {
+          vertex = vertex_pool.construct();
+          owned.push_back(vertex);
+        }
+        util::Pool &pool = task.entry ? task.entry->pool : phrase_pool;
+        vertex->InitRoot();
+        AddTargetPhrasesToVertex(rows, *vertex, pool);
+        vertex->FinishRoot(search::kPolicyLeft);
+        SetRange(task.begin, task.end, vertex);
+      }
+    }
+
     void SetRange(std::size_t begin, std::size_t end, TargetPhrases *to) {
       assert(end - begin <= max_source_phrase_length_);
       assert(begin * max_source_phrase_length_ + end - begin - 1 < entries_.size());
@@ -105,14 +187,39 @@ class Chart {
         const pt::Row *phrase,
         search::Vertex &vertex,
         TargetPhraseType type,
-        bool use_cache);
+        util::Pool &phrase_pool);
+
+    // AddTargetPhraseToVertex for every row of a span from the phrase table,
+    // letting the language model share work between the rows.
+    void AddTargetPhrasesToVertex(
+        const std::vector<const pt::Row*> &phrases,
+        search::Vertex &vertex,
+        util::Pool &phrase_pool);
+
+    // Pinned cache entry for the span or NULL if it is not cached.
+    VertexCache::Entry *AcquireCached(std::size_t begin, std::size_t end);
 
     void AddPassthrough(std::size_t position);
 
+    void RescoreVertex(search::Vertex &vertex, TargetPhraseType type);
+
     VocabMap vocab_map_;
 
     boost::object_pool<search::Vertex> vertex_pool_;
     util::Pool target_phrase_pool_;
+    // Vertices constructed in vertex_pool_.
+    std::vector<search::Vertex*> vertices_;
+
+    boost::ptr_vector<WorkerAllocators> worker_allocators_;
+
+    // Cache entries queued for loading in this sentence.
+    boost::unordered_set<VertexCache::Entry*> loading_;
+
+    // Cache entries acquired, to release in the destructor.
+    std::vector<VertexCache::Entry*> acquired_;
+
+    // Words with lower ids are in the phrase table's vocabulary.
+    const std::size_t base_vocab_size_;
 
     Objective &objective_;
     FeatureInit &feature_init_;
@@ -125,14 +232,14 @@ class Chart {
 
     pt::Row *eos_phrase_;
 
+    // Vertices made by AddPassthrough.
+    std::vector<TargetPhrases*> passthroughs_;
+
     // Banded array: different source lengths are next to each other.
     std::vector<TargetPhrases*> entries_;
 
     const std::size_t max_source_phrase_length_;
-    const std::size_t cached_phrase_max_length_ = 2;
 
-    // TODO replace with something better, possibly remove totally.
-    // or at least pre-fill and make constant
     VertexCache &cache_;
 };
 
@@ -4,9 +4,12 @@
 #include "pt/access.hh"
 #include "lm/model.hh"
 
+#include <algorithm>
 #include <string>
 #include <unordered_map>
 
+#include <string.h>
+
 #define BOOST_TEST_MODULE ChartTest
 #include <boost/test/unit_test.hpp>
 
@@ -129,5 +132,146 @@ BOOST_AUTO_TEST_CASE(ReadSentenceTest) {
   BOOST_CHECK_EQUAL("test", rep_buffer[1]);
 }
 
+// Scores each target phrase by where its row is in rows and gives every
+// phrase the same language model state, without touching shared state.
+class RowScoreMock : public Feature, public ObjectiveBypass {
+  public:
+    RowScoreMock(const FeatureInit &init, const char *rows) : Feature("row"), init_(init), rows_(rows) {}
+
+    void Init(FeatureInit &feature_init) override {}
+    void NewWord(const StringPiece string_rep, VocabWord *word) const override {}
+    void InitPassthroughPhrase(pt::Row *passthrough, TargetPhraseType type) const override {}
+    void ScoreTargetPhrase(TargetPhraseInfo target, ScoreCollector &collector) const override {
+      const char *row = reinterpret_cast<const char*>(init_.pt_row_field(target.phrase));
+      collector.AddDense(0, row ? -static_cast<float>(row - rows_) : -100.0);
+    }
+    void ScoreHypothesisWithSourcePhrase(
+        const Hypothesis &hypothesis, const SourcePhrase source_phrase, ScoreCollector &collector) const override {}
+    void ScoreHypothesisWithPhrasePair(
+        const Hypothesis &hypothesis, PhrasePair phrase_pair, ScoreCollector &collector) const override {}
+    void ScoreFinalHypothesis(
+        const Hypothesis &hypothesis, ScoreCollector &collector) const override {}
+    bool HypothesisEqual(const Hypothesis &first, const Hypothesis &second) const override { return true; }
+    std::size_t DenseFeatureCount() const override { return 1; }
+    std::string FeatureDescription(std::size_t index) const override { return ""; }
+    void InitTargetPhrase(TargetPhraseInfo target, lm::ngram::ChartState &state) const override {
+      memset(&state, 0, sizeof(state));
+    }
+    void SetSearchScore(Hypothesis *new_hypo, float score) const override {}
+
+  private:
+    const FeatureInit &init_;
+    const char *rows_;
+};
+
+// Phrase table whose rows are bytes of rows_, chosen by the source words so
+// that a repeated phrase gets the same rows.  Some phrases have none.
+class TableMock {
+  public:
+    class Iterator {
+      public:
+        explicit Iterator(const char *at) : at_(at) {}
+        const pt::Row &operator*() const { return *reinterpret_cast<const pt::Row*>(at_); }
+        Iterator &operator++() { ++at_; return *this; }
+        bool operator!=(const Iterator &other) const { return at_ != other.at_; }
+      private:
+        const char *at_;
+    };
+
+    struct Rows {
+      Iterator begin() const { return Iterator(begin_); }
+      Iterator end() const { return Iterator(end_); }
+      bool operator!() const { return begin_ == end_; }
+      const char *begin_, *end_;
+    };
+
+    explicit TableMock(const char *rows) : rows_(rows) {}
+
+    Rows Lookup(const ID *begin, const ID *end) const {
+      std::size_t hash = end - begin;
+      for (const ID *i = begin; i != end; ++i) hash = hash * 31 + *i;
+      Rows ret;
+      ret.begin_ = rows_ + hash % 40;
+      ret.end_ = ret.begin_ + hash % 5;
+      return ret;
+    }
+
+  private:
+    const char *rows_;
+};
+
+struct LoadedChart {
+  LoadedChart(Objective &objective, const BaseVocab &vocab, const TableMock &table, StringPiece sentence, std::size_t threads)
+    : cache(CacheConfig()), chart(3, vocab, objective, cache), workers(threads) {
+    chart.ReadSentence(sentence);
+    chart.LoadPhrases(table, workers, threads);
+  }
+
+  static VertexCache::Config CacheConfig() {
+    VertexCache::Config config;
+    config.admit_count = 1;
+    return config;
+  }
+
+  Chart::VertexCache cache;
+  Chart chart;
+  Workers workers;
+};
+
+// Index of the phrase's row in rows or -1 for a passthrough, whose row
+// belongs to the chart.
+long RowIndex(Objective &objective, const char *rows, const TargetPhrase *phrase) {
+  const char *row = reinterpret_cast<const char*>(objective.GetFeatureInit().pt_row_field(phrase));
+  return (row >= rows && row < rows + 64) ? row - rows : -1;
+}
+
+BOOST_AUTO_TEST_CASE(ThreadsTest) {
+  pt::FieldConfig config;
+  pt::Access access(config);
+  lm::ngram::State lm_state;
+  Objective objective(access, lm_state);
+  char rows[64];
+  RowScoreMock feature(objective.GetFeatureInit(), rows);
+  objective.AddFeature(feature);
+  objective.RegisterLanguageModel(feature);
+  objective.weights.push_back(1.0);
+  BaseVocab base_vocab;
+  const char *words[] = {"a", "b", "c", "d", "e"};
+  for (std::size_t i = 0; i < 5; ++i) base_vocab.vocab.FindOrInsert(words[i]);
+  util::Layout &word_layout = objective.GetFeatureInit().word_layout;
+  while (base_vocab.map.size() < base_vocab.vocab.Size()) {
+    base_vocab.map.push_back(reinterpret_cast<VocabWord*>(word_layout.Allocate(base_vocab.pool)));
+  }
+  TableMock table(rows);
+
+  // Repeats share cache entries and unknown words bypass the cache.
+  const char *sentence = "a b c d e a b c unknown a b";
+  LoadedChart single(objective, base_vocab, table, sentence, 1);
+  LoadedChart multi(objective, base_vocab, table, sentence, 3);
+
+  const Chart &expected = single.chart, &actual = multi.chart;
+  BOOST_REQUIRE_EQUAL(expected.SentenceLength(), actual.SentenceLength());
+  std::size_t loaded = 0;
+  for (std::size_t begin = 0; begin < expected.SentenceLength(); ++begin) {
+    for (std::size_t end = begin + 1; end <= std::min(expected.SentenceLength(), begin + 3); ++end) {
+      TargetPhrases *expected_range = expected.Range(begin, end), *actual_range = actual.Range(begin, end);
+      BOOST_REQUIRE_EQUAL(!expected_range, !actual_range);
+      if (!expected_range) continue;
+      ++loaded;
+      const std::vector<search::HypoState> &expected_hypos = expected_range->ReopenRoot();
+      const std::vector<search::HypoState> &actual_hypos = actual_range->ReopenRoot();
+      BOOST_REQUIRE_EQUAL(expected_hypos.size(), actual_hypos.size());
+      for (std::size_t i = 0; i < expected_hypos.size(); ++i) {
+        const TargetPhrase *expected_phrase = reinterpret_cast<const TargetPhrase*>(expected_hypos[i].history.cvp);
+        const TargetPhrase *actual_phrase = reinterpret_cast<const TargetPhrase*>(actual_hypos[i].history.cvp);
+        BOOST_CHECK_EQUAL(RowIndex(objective, rows, expected_phrase), RowIndex(objective, rows, actual_phrase));
+        BOOST_CHECK_EQUAL(expected_hypos[i].score, actual_hypos[i].score);
+      }
+    }
+  }
+  // Every word has a phrase or passthrough and some longer spans are loaded.
+  BOOST_CHECK(loaded > expected.SentenceLength());
+}
+
 } // namespace
 } // namespace decode
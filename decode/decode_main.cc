@@ -1,14 +1,20 @@
 #include "decode/system.hh"
 #include "decode/chart.hh"
 #include "decode/output.hh"
+#include "decode/segment.hh"
 #include "decode/stacks.hh"
+#include "decode/translation_cache.hh"
 #include "decode/weights.hh"
 #include "pt/query.hh"
 #include "pt/statistics.hh"
 #include "pt/access.hh"
 #include "pt/create.hh"
+#include "util/counter.hh"
+#include "util/file.hh"
 #include "util/file_stream.hh"
+#include "util/murmur_hash.hh"
 #include "util/mutable_vocab.hh"
+#include "util/string_stream.hh"
 #include "util/usage.hh"
 
 // features
@@ -20,58 +26,409 @@
 #include "decode/lm.hh"
 #include "decode/lexro.hh"
 
+#include "lm/binary_format.hh"
+#include "lm/max_order.hh"
+#include "lm/model.hh"
+#include "util/exception.hh"
+
 #include <boost/program_options.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/scoped_ptr.hpp>
 
+#include <algorithm>
+#include <limits>
+#include <signal.h>
+#include <sys/stat.h>
 #include <string>
 #include <vector>
 
 namespace decode {
-void Decode(System &system, const pt::Table &table, Chart::VertexCache &cache,
-    const StringPiece in,
-    ScoreHistoryMap &history_map, bool verbose, util::FileStream &out) {
-  Chart chart(table.Stats().max_source_phrase_length, system.GetBaseVocab(), system.GetObjective(), cache);
-  chart.ReadSentence(in);
-  chart.LoadPhrases(table);
-  Stacks stacks(system, chart);
+// Appends the words of the translation of the chart's sentence or segment to
+// words and, unless feature_values is NULL, adds its feature values to them.
+// Returns its score or -infinity if there is none.  A segment continues from
+// begin_state unless it is NULL and, unless end_sentence, stores the state
+// it ends in to end_state.  If memory is not NULL, reports this search's
+// memory and adds it to memory.
+template <class Model> float Search(System &system, Chart &chart, const Model &model,
+    const lm::ngram::Right *begin_state, bool end_sentence, lm::ngram::Right *end_state,
+    ScoreHistoryMap &history_map, util::PoolReport *memory, util::StringStream &words,
+    std::vector<float> *feature_values) {
+  Stacks stacks(system, chart, model, begin_state, end_sentence);
   const Hypothesis *hyp = stacks.End();
+  if (memory) {
+    util::PoolReport sentence;
+    chart.ReportMemory(sentence);
+    stacks.ReportMemory(sentence);
+    std::cerr << "Sentence memory:\n";
+    sentence.Print(std::cerr);
+    memory->Add(sentence);
+  }
 	
   history_map.clear();
 	
+  float score = -std::numeric_limits<float>::infinity();
   if (hyp) {
-    Output(*hyp, chart.VocabMapping(), history_map, out, system.GetObjective().GetFeatureInit(), verbose);
-    std::cerr << "score: " << hyp->GetScore() << std::endl;
+    Output(*hyp, chart.VocabMapping(), history_map, words, system.GetObjective().GetFeatureInit(), false, end_sentence);
+    score = hyp->GetScore();
+    if (end_state) *end_state = stacks.EndState(system.GetObjective().GetFeatureInit());
   }
-  out << '\n';
 
-  if (verbose && hyp) {
-    std::vector<float> feature_values(system.GetObjective().weights.size());
+  if (feature_values && hyp) {
     while (hyp->Previous() && hyp->Target()) {
       std::size_t i = 0;
       for (float v : system.GetObjective().GetFeatureValues(*hyp)) {
-        feature_values[i++] += v;
+        (*feature_values)[i++] += v;
       }
       hyp = hyp->Previous();
     }
-    std::cerr << "feature values (weighted): [ \n";
-    std::size_t i = 0;
-    for (auto value : feature_values) {
-      std::cerr << system.GetObjective().FeatureDescription(i) << ": " << value <<
-        " (" << value * system.GetObjective().weights[i] << ")" << std::endl;
-      i++;
+  }
+  return score;
+}
+
+// Writes a whole translation with its score, or just ends the line if there
+// is none (score is -infinity).  Verbose output starts with the score and
+// reports the feature values summed over the sentence.
+template <class Stream> void EndTranslation(const Objective &objective, float score, const util::StringStream &words,
+    const std::vector<float> &feature_values, bool verbose, Stream &out) {
+  if (score != -std::numeric_limits<float>::infinity()) {
+    if (verbose) out << score;
+    out << words.str();
+    if (verbose) {
+      std::cerr << "feature values (weighted): [ \n";
+      std::size_t i = 0;
+      for (auto value : feature_values) {
+        std::cerr << objective.FeatureDescription(i) << ": " << value <<
+          " (" << value * objective.weights[i] << ")" << std::endl;
+        i++;
+      }
+      std::cerr << "]\n";
     }
-    std::cerr << "]\n";
+    std::cerr << "score: " << score << std::endl;
   }
+  out << '\n';
 }
+
+// Every feature but the language model.  Features keep fields of the System
+// they were added to, so each System needs its own.
+struct Features {
+  Distortion distortion;
+  Passthrough passthrough;
+  WordInsertion word_insert;
+  PhraseCountFeature phrase_count_feature;
+  PhraseTableFeatures pt_features;
+  LexicalizedReordering lexro;
+};
+
+template <class Model> void AddFeatures(System &sys, Features &features, LM<Model> &lm,
+    pt::Table &table, const Weights &weights, bool verbose) {
+  sys.GetObjective().AddFeature(features.distortion);
+  sys.GetObjective().AddFeature(features.passthrough);
+  sys.GetObjective().AddFeature(features.word_insert);
+  sys.GetObjective().AddFeature(features.phrase_count_feature);
+  sys.GetObjective().AddFeature(features.pt_features);
+  sys.GetObjective().AddFeature(lm);
+  sys.GetObjective().RegisterLanguageModel(lm);
+  sys.GetObjective().AddFeature(features.lexro);
+
+  sys.LoadVocab(table.Vocab(), table.Stats().vocab_size);
+  sys.GetObjective().SetStoreFeatureValues(verbose);
+  sys.GetObjective().LoadWeights(weights);
+}
+
+struct CoarseOptions {
+  // Empty disables the coarse pass.
+  std::string lm_file;
+  unsigned int pop_limit = 1000;
+  // The pass has its own vertex cache on top of --vertex-cache.
+  VertexCache::Config cache;
+};
+
+// First pass of coarse-to-fine decoding: search with a small language model
+// and a large beam, then keep only the target phrases used by the complete
+// hypotheses that survive.  The full model searches among those, so it
+// scores fewer phrases.  One-word phrases are always kept; see LoadPhrases.
+class CoarsePass {
+  public:
+    typedef lm::ngram::ProbingModel Model;
+
+    CoarsePass(const Config &config, const CoarseOptions &options, pt::Table &table,
+        const Weights &weights)
+      : lm_(CheckProbing(options.lm_file).c_str(), config.lm_prefetch_group),
+        system_(WithPopLimit(config, options.pop_limit), table.Accessor(), weights, lm_.GetModel().BeginSentenceState()),
+        cache_(options.cache) {
+      AddFeatures(system_, features_, lm_, table, weights, false);
+    }
+
+    // Fill rows for the full search of the sentence.  Returns false if the
+    // coarse search found no translation, so the full search should use
+    // every phrase.
+    bool Rows(const pt::Table &table, const StringPiece in, RowSet &rows) {
+      Chart chart(table.Stats().max_source_phrase_length, system_.GetBaseVocab(), system_.GetObjective(), cache_);
+      chart.ReadSentence(in);
+      chart.LoadPhrases(table, system_.GetWorkers(), system_.GetConfig().phrase_threads);
+      Stacks stacks(system_, chart, lm_.GetModel());
+      if (!stacks.End()) return false;
+      stacks.CompleteRows(system_.GetObjective().GetFeatureInit(), rows);
+      return true;
+    }
+
+  private:
+    static const std::string &CheckProbing(const std::string &file) {
+      lm::ngram::ModelType model_type;
+      UTIL_THROW_IF(lm::ngram::RecognizeBinary(file.c_str(), model_type) && model_type != lm::ngram::PROBING,
+          util::Exception, "The coarse language model " << file << " must be ARPA or a probing binary.");
+      return file;
+    }
+
+    static Config WithPopLimit(Config config, unsigned int pop_limit) {
+      config.pop_limit = pop_limit;
+      return config;
+    }
+
+    Features features_;
+    LM<Model> lm_;
+    System system_;
+    // Vertices hold states of the coarse model, so they can't be shared.
+    VertexCache cache_;
+};
+
+// Search overlong sentences in segments, continuing the language model
+// state of each in the next; see SplitSentence.  The translation is written
+// only if every segment has one, so a sentence is translated whole or not
+// at all.  Returns the total score or -infinity.
+template <class Model, class Stream> float DecodeSegments(System &system, const pt::Table &table, const Model &model,
+    VertexCache &cache, CoarsePass *coarse, const StringPiece in,
+    ScoreHistoryMap &history_map, bool verbose, util::PoolReport *memory, Stream &out) {
+  std::vector<StringPiece> segments;
+  SplitSentence(in, system.GetConfig().max_segment_words, segments);
+  float score = 0.0;
+  lm::ngram::Right state;
+  util::StringStream words;
+  std::vector<float> feature_values(verbose ? system.GetObjective().weights.size() : 0);
+  for (std::size_t i = 0; i < segments.size(); ++i) {
+    RowSet rows;
+    const RowSet *keep = NULL;
+    if (coarse && coarse->Rows(table, segments[i], rows)) keep = &rows;
+    Chart chart(table.Stats().max_source_phrase_length, system.GetBaseVocab(), system.GetObjective(), cache);
+    chart.ReadSentence(segments[i]);
+    chart.LoadPhrases(table, system.GetWorkers(), system.GetConfig().phrase_threads, keep);
+    const bool last = (i + 1 == segments.size());
+    score += Search(system, chart, model, i ? &state : NULL, last, last ? NULL : &state, history_map, memory, words,
+        verbose ? &feature_values : NULL);
+    if (score == -std::numeric_limits<float>::infinity()) break;
+  }
+  EndTranslation(system.GetObjective(), score, words, feature_values, verbose, out);
+  return score;
+}
+
+// translations may be NULL to always decode.  coarse may be NULL to search
+// every phrase with the full model.
+template <class Model> void Decode(System &system, const pt::Table &table, const Model &model,
+    VertexCache &cache, TranslationCache *translations, CoarsePass *coarse, const StringPiece in,
+    ScoreHistoryMap &history_map, bool verbose, util::PoolReport *memory, util::FileStream &out) {
+  TranslationCache::Key key;
+  if (translations) {
+    key = translations->MakeKey(in);
+    std::string cached;
+    float score;
+    if (translations->Find(key, cached, score)) {
+      out << cached;
+      if (score != -std::numeric_limits<float>::infinity()) std::cerr << "score: " << score << std::endl;
+      return;
+    }
+  }
+  if (!translations) {
+    DecodeSegments(system, table, model, cache, coarse, in, history_map, verbose, memory, out);
+    return;
+  }
+  util::StringStream translation;
+  float score = DecodeSegments(system, table, model, cache, coarse, in, history_map, verbose, memory, translation);
+  out << translation.str();
+  if (score != -std::numeric_limits<float>::infinity()) translations->Insert(key, translation.str(), score);
+}
+
+struct TranslationCacheOptions {
+  // 0 disables the cache.
+  std::size_t megabytes = 0;
+  // Loaded before decoding and saved after, unless empty.
+  std::string file;
+  // Hash of the models and output options.
+  uint64_t seed = 0;
+};
+
+// Everything other than the input that decides a translation.
+uint64_t TranslationFingerprint(const Config &config, const std::vector<float> &weights, uint64_t seed) {
+  const uint64_t search[4] = {config.reordering_limit, config.pop_limit, config.future_distortion, config.max_segment_words};
+  uint64_t hash = util::MurmurHashNative(search, sizeof(search), seed);
+  return util::MurmurHashNative(&*weights.begin(), weights.size() * sizeof(float), hash);
+}
+
+// Identifies a model file for the translation cache by its size,
+// modification time, and first and last bytes, where the binary formats keep
+// their headers, so a file rebuilt under the same name gets another identity.
+uint64_t FileIdentity(const std::string &name) {
+  const std::size_t kEnds = 1 << 16;
+  util::scoped_fd fd(util::OpenReadOrThrow(name.c_str()));
+  struct stat info;
+  UTIL_THROW_IF(fstat(fd.get(), &info), util::ErrnoException, "Could not stat " << name);
+  const uint64_t stats[2] = {(uint64_t)info.st_size, (uint64_t)info.st_mtime};
+  uint64_t hash = util::MurmurHashNative(stats, sizeof(stats), util::MurmurHashNative(name.data(), name.size()));
+  std::vector<char> bytes(std::min<uint64_t>(kEnds, info.st_size));
+  if (bytes.empty()) return hash;
+  util::ErsatzPRead(fd.get(), &bytes[0], bytes.size(), 0);
+  hash = util::MurmurHashNative(&bytes[0], bytes.size(), hash);
+  util::ErsatzPRead(fd.get(), &bytes[0], bytes.size(), info.st_size - bytes.size());
+  return util::MurmurHashNative(&bytes[0], bytes.size(), hash);
+}
+
+// Load every sentence's chart once, then search all of them again for each
+// set of weights.  Output is one block of translations per set of weights.
+template <class Model> void Sweep(System &system, const pt::Table &table, const Model &model,
+    VertexCache &cache, util::FilePiece &in, const std::vector<Weights> &sweep,
+    ScoreHistoryMap &history_map, bool verbose, util::PoolReport *memory, util::FileStream &out) {
+  boost::ptr_vector<Chart> charts;
+  while (true) {
+    StringPiece line;
+    try {
+      line = in.ReadLine();
+    } catch (const util::EndOfFileException &e) { break; }
+    charts.push_back(new Chart(table.Stats().max_source_phrase_length, system.GetBaseVocab(), system.GetObjective(), cache));
+    charts.back().ReadSentence(line);
+    charts.back().LoadPhrases(table, system.GetWorkers(), system.GetConfig().phrase_threads);
+    in.UpdateProgress();
+  }
+  for (std::size_t w = 0; w < sweep.size(); ++w) {
+    system.LoadWeights(sweep[w]);
+    for (std::size_t i = 0; i < charts.size(); ++i) {
+      std::cerr << "weights " << w << " sentence " << i << std::endl;
+      charts[i].Rescore();
+      util::StringStream words;
+      std::vector<float> feature_values(verbose ? system.GetObjective().weights.size() : 0);
+      float score = Search(system, charts[i], model, NULL, true, NULL, history_map, memory, words,
+          verbose ? &feature_values : NULL);
+      EndTranslation(system.GetObjective(), score, words, feature_values, verbose, out);
+      out.flush();
+    }
+  }
+}
+
+// Memory summed over sentences, with the high water of any one sentence,
+// followed by what persists between sentences.
+void ReportJoinMemo(const search::JoinMemo &memo) {
+  std::cerr << "LM join memo: " << memo.Hits() << " hits in " << memo.Lookups() << " lookups";
+  if (memo.Lookups()) std::cerr << " (" << (100.0 * memo.Hits() / memo.Lookups()) << "%)";
+  std::cerr << ", " << memo.JoinsSaved() << " joins saved, " << memo.Bypassed() << " bypassed on sentences with few hits" << std::endl;
+}
+
+void ReportProcessMemory(util::PoolReport *sentences, const search::JoinMemo &memo, const VertexCache &cache, TranslationCache *translations) {
+  if (!sentences) return;
+  std::cerr << "Memory over all sentences:\n";
+  sentences->Print(std::cerr);
+  util::PoolReport persistent;
+  cache.ReportMemory(persistent);
+  persistent.AddBytes("search/join_memo", memo.MemoryBytes());
+  if (translations) translations->ReportMemory(persistent);
+  std::cerr << "Memory kept between sentences:\n";
+  persistent.Print(std::cerr);
+}
+
+// Everything after option parsing, for the type of language model loaded.
+template <class Model> void Run(const Config &config, pt::Table &table,
+    const std::string &lm_file, const std::string &weights_file,
+    const std::vector<std::string> &sweep_files, const VertexCache::Config &vertex_cache_config,
+    const TranslationCacheOptions &cache_options, const CoarseOptions &coarse_options, bool memory_report, bool verbose) {
+  UTIL_THROW_IF2(!sweep_files.empty() && table.Accessor().weights_folded,
+      "--sweep can't change the weights folded into the phrase table.  Binarize it without --fold.");
+  Weights weights;
+  weights.ReadFromFile(weights_file);
+  Features features;
+  LM<Model> lm(lm_file.c_str(), config.lm_prefetch_group);
+  if ((verbose || memory_report) && lm.GetModel().Order() < KENLM_MAX_ORDER) {
+    // Every LM state in search is sized for KENLM_MAX_ORDER.
+    std::cerr << "The language model is order " << (unsigned)lm.GetModel().Order()
+      << " but this build supports up to " << KENLM_MAX_ORDER
+      << ", so each search state takes " << sizeof(lm::ngram::ChartState) << " bytes.  Build with -DKENLM_MAX_ORDER="
+      << (unsigned)lm.GetModel().Order() << " to shrink them." << std::endl;
+  }
+
+  System sys(config, table.Accessor(), weights, lm.GetModel().BeginSentenceState());
+  AddFeatures(sys, features, lm, table, weights, verbose);
+  boost::scoped_ptr<CoarsePass> coarse;
+  if (!coarse_options.lm_file.empty()) {
+    UTIL_THROW_IF2(!sweep_files.empty(), "--coarse-lm does not support --sweep.");
+    coarse.reset(new CoarsePass(config, coarse_options, table, weights));
+  }
+
+  util::FilePiece f(0, NULL, &std::cerr);
+  util::FileStream out(1);
+  VertexCache cache(vertex_cache_config);
+  ScoreHistoryMap history_map;
+  // Sum over sentences.
+  util::PoolReport memory;
+  if (!sweep_files.empty()) {
+    UTIL_THROW_IF2(cache_options.megabytes, "The translation cache does not support --sweep.");
+    UTIL_THROW_IF2(config.max_segment_words, "--max-segment-words does not support --sweep.");
+    std::vector<Weights> sweep(sweep_files.size());
+    for (std::size_t w = 0; w < sweep_files.size(); ++w) {
+      sweep[w].ReadFromFile(sweep_files[w]);
+    }
+    Sweep(sys, table, lm.GetModel(), cache, f, sweep, history_map, verbose, memory_report ? &memory : NULL, out);
+    if (vertex_cache_config.max_bytes) cache.Report(std::cerr);
+    if (config.join_memo_slots) ReportJoinMemo(sys.GetJoinMemo());
+    ReportProcessMemory(memory_report ? &memory : NULL, sys.GetJoinMemo(), cache, NULL);
+    util::PrintUsage(std::cerr);
+    return;
+  }
+  boost::scoped_ptr<TranslationCache> translations;
+  if (cache_options.megabytes) {
+    translations.reset(new TranslationCache(cache_options.megabytes << 20,
+          TranslationFingerprint(config, sys.GetObjective().weights, cache_options.seed)));
+    if (!cache_options.file.empty()) translations->Load(cache_options.file.c_str());
+  }
+  std::size_t i = 0;
+  while (true) {
+    StringPiece line;
+    try {
+      line = f.ReadLine();
+    } catch (const util::EndOfFileException &e) { break; }
+    util::PrintUsage(std::cerr);
+    std::cerr << "sentence " << i++ << std::endl;
+    Decode(sys, table, lm.GetModel(), cache, translations.get(), coarse.get(), line, history_map, verbose, memory_report ? &memory : NULL, out);
+    out.flush();
+    f.UpdateProgress();
+  }
+  if (translations) {
+    translations->Report(std::cerr);
+    if (!cache_options.file.empty()) translations->Save(cache_options.file.c_str());
+  }
+  if (vertex_cache_config.max_bytes) cache.Report(std::cerr);
+  if (config.join_memo_slots) ReportJoinMemo(sys.GetJoinMemo());
+  ReportProcessMemory(memory_report ? &memory : NULL, sys.GetJoinMemo(), cache, translations.get());
+  util::PrintUsage(std::cerr);
+}
+
 } // namespace decode
 
 int main(int argc, char *argv[]) {
   try {
+#ifdef UTIL_COUNTERS
+    // Counters are also printed at exit.
+    util::DumpCountersOnSignal(SIGUSR1);
+#endif
     namespace po = boost::program_options;
     po::options_description options("Decoder options");
     std::string lm_file, phrase_file;
     std::string weights_file;
     decode::Config config;
     bool verbose = false;
+    bool memory_report = false;
+    pt::RowCount ttable_limit = 0;
+    std::vector<std::string> sweep_files;
+    decode::TranslationCacheOptions cache_options;
+    decode::CoarseOptions coarse_options;
+    coarse_options.cache.max_bytes = 64 << 20;
+    std::size_t vertex_cache_mb, coarse_vertex_cache_mb;
+    decode::VertexCache::Config vertex_cache_config;
 
     options.add_options()
       ("verbose,v", "Produce verbose output")
@@ -79,7 +436,23 @@ int main(int argc, char *argv[]) {
       ("phrase,p", po::value<std::string>(&phrase_file)->required(), "Phrase table")
       ("weights_file,W", po::value<std::string>(&weights_file)->required(), "Weights file")
       ("beam,K", po::value<unsigned int>(&config.pop_limit)->required(), "Beam size")
-      ("reordering,R", po::value<std::size_t>(&config.reordering_limit)->required(), "Reordering limit");
+      ("reordering,R", po::value<std::size_t>(&config.reordering_limit)->required(), "Reordering limit")
+      ("future-distortion", po::bool_switch(&config.future_distortion), "Include the minimum distortion left to pay in future cost estimates")
+      ("phrase-threads", po::value<std::size_t>(&config.phrase_threads)->default_value(1), "Threads to look up and score the phrases of each sentence")
+      ("expand-threads", po::value<std::size_t>(&config.expand_threads)->default_value(1), "Threads to extend antecedent hypotheses into each stack")
+      ("max-segment-words", po::value<std::size_t>(&config.max_segment_words)->default_value(config.max_segment_words), "Split longer sentences, at punctuation where possible, into segments searched in turn with the language model context carried across.  Bounds search time per word.  0 disables.")
+      ("ttable-limit", po::value<pt::RowCount>(&ttable_limit)->default_value(0), "Use at most this many target phrases per source phrase, taking them in table order.  0 uses all.")
+      ("sweep", po::value<std::vector<std::string> >(&sweep_files)->multitoken(), "Weights files to decode the whole input with in turn, loading phrases only once.  Translations are output in one block per file.")
+      ("translation-cache", po::value<std::size_t>(&cache_options.megabytes)->default_value(0), "Megabytes of memory for reusing the translations of repeated input lines.  0 disables.")
+      ("join-memo", po::value<std::size_t>(&config.join_memo_slots)->default_value(config.join_memo_slots), "Slots remembering language model joins during search, e.g. 16384.  Helps with language models larger than the cache.  0 disables.")
+      ("lm-prefetch-group", po::value<std::size_t>(&config.lm_prefetch_group)->default_value(config.lm_prefetch_group), "Target phrase words to score together after prefetching their language model entries, e.g. 16.  Helps probing models larger than the cache.  1 disables.")
+      ("coarse-lm", po::value<std::string>(&coarse_options.lm_file), "Small language model, ARPA or probing, for a first pass.  The full search then only considers target phrases of complete hypotheses that survive the first pass.")
+      ("coarse-beam", po::value<unsigned int>(&coarse_options.pop_limit)->default_value(coarse_options.pop_limit), "Beam size of the --coarse-lm pass")
+      ("coarse-vertex-cache", po::value<std::size_t>(&coarse_vertex_cache_mb)->default_value(coarse_options.cache.max_bytes >> 20), "Megabytes of memory for the vertex cache of the --coarse-lm pass.  Its vertices hold states of the coarse model, so it is separate from and in addition to --vertex-cache.  0 disables.")
+      ("vertex-cache", po::value<std::size_t>(&vertex_cache_mb)->default_value(vertex_cache_config.max_bytes >> 20), "Megabytes of memory for the target phrases of source phrases that recur across sentences.  --coarse-lm has its own; see --coarse-vertex-cache.  0 disables.")
+      ("vertex-cache-admit", po::value<unsigned int>(&vertex_cache_config.admit_count)->default_value(vertex_cache_config.admit_count), "Times a source phrase is seen before its target phrases are cached, in both vertex caches")
+      ("memory-report", po::bool_switch(&memory_report), "Report memory by pool for each sentence and at the end")
+      ("translation-cache-file", po::value<std::string>(&cache_options.file), "Load the translation cache from this file if it exists and save it there at the end.  Requires --translation-cache.");
     if (argc == 1) {
       std::cerr << options << std::endl;
       return 1;
@@ -92,52 +465,48 @@ int main(int argc, char *argv[]) {
         verbose = true;
     }
 
+    vertex_cache_config.max_bytes = vertex_cache_mb << 20;
+    coarse_options.cache.max_bytes = coarse_vertex_cache_mb << 20;
+    coarse_options.cache.admit_count = vertex_cache_config.admit_count;
+
     pt::Table table(phrase_file.c_str(), util::READ);
+    if (ttable_limit) table.LimitRows(ttable_limit);
+    UTIL_THROW_IF2(!cache_options.file.empty() && !cache_options.megabytes, "--translation-cache-file requires --translation-cache.");
+    // Identifying the model files reads them, so only for the cache.
+    if (cache_options.megabytes) {
+      const uint64_t identity[5] = {
+        decode::FileIdentity(phrase_file),
+        decode::FileIdentity(lm_file),
+        (uint64_t)ttable_limit * 2 + verbose,
+        coarse_options.lm_file.empty() ? 0 : decode::FileIdentity(coarse_options.lm_file),
+        coarse_options.lm_file.empty() ? 0 : coarse_options.pop_limit};
+      cache_options.seed = util::MurmurHashNative(identity, sizeof(identity));
+    }
 
-    decode::Weights weights;
-    weights.ReadFromFile(weights_file);
-    decode::Distortion distortion;
-    decode::Passthrough passthrough;
-    decode::WordInsertion word_insert;
-    decode::PhraseCountFeature phrase_count_feature;
-    decode::PhraseTableFeatures pt_features;
-    decode::LM lm(lm_file.c_str());
-    decode::LexicalizedReordering lexro;
-
-    decode::System sys(config, table.Accessor(), weights, lm.Model());
-    sys.GetObjective().AddFeature(distortion);
-    sys.GetObjective().AddFeature(passthrough);
-    sys.GetObjective().AddFeature(word_insert);
-    sys.GetObjective().AddFeature(phrase_count_feature);
-    sys.GetObjective().AddFeature(pt_features);
-    sys.GetObjective().AddFeature(lm);
-    sys.GetObjective().RegisterLanguageModel(lm);
-    sys.GetObjective().AddFeature(lexro);
-
-    sys.LoadVocab(table.Vocab(), table.Stats().vocab_size);
-    sys.GetObjective().SetStoreFeatureValues(verbose);
-    sys.GetObjective().LoadWeights(weights);
-
-    util::FilePiece f(0, NULL, &std::cerr);
-    util::FileStream out(1);
-    decode::Chart::VertexCache cache(15000000); // TODO non-hardcode
-    // TODO vocab map originally exists to avoid having a global dictionary.
-    // it is now here because we need backing for cache, which only exists
-    // to make speed comparable to the previous mtplz
-    decode::ScoreHistoryMap history_map;
-    std::size_t i = 0;
-    while (true) {
-      StringPiece line;
-      try {
-        line = f.ReadLine();
-      } catch (const util::EndOfFileException &e) { break; }
-      util::PrintUsage(std::cerr);
-      std::cerr << "sentence " << i++ << std::endl;
-      decode::Decode(sys, table, cache, line, history_map, verbose, out);
-      out.flush();
-      f.UpdateProgress();
+    lm::ngram::ModelType model_type;
+    if (!lm::ngram::RecognizeBinary(lm_file.c_str(), model_type)) model_type = lm::ngram::PROBING;
+    switch (model_type) {
+      case lm::ngram::PROBING:
+        decode::Run<lm::ngram::ProbingModel>(config, table, lm_file, weights_file, sweep_files, vertex_cache_config, cache_options, coarse_options, memory_report, verbose);
+        break;
+      case lm::ngram::REST_PROBING:
+        decode::Run<lm::ngram::RestProbingModel>(config, table, lm_file, weights_file, sweep_files, vertex_cache_config, cache_options, coarse_options, memory_report, verbose);
+        break;
+      case lm::ngram::TRIE:
+        decode::Run<lm::ngram::TrieModel>(config, table, lm_file, weights_file, sweep_files, vertex_cache_config, cache_options, coarse_options, memory_report, verbose);
+        break;
+      case lm::ngram::QUANT_TRIE:
+        decode::Run<lm::ngram::QuantTrieModel>(config, table, lm_file, weights_file, sweep_files, vertex_cache_config, cache_options, coarse_options, memory_report, verbose);
+        break;
+      case lm::ngram::ARRAY_TRIE:
+        decode::Run<lm::ngram::ArrayTrieModel>(config, table, lm_file, weights_file, sweep_files, vertex_cache_config, cache_options, coarse_options, memory_report, verbose);
+        break;
+      case lm::ngram::QUANT_ARRAY_TRIE:
+        decode::Run<lm::ngram::QuantArrayTrieModel>(config, table, lm_file, weights_file, sweep_files, vertex_cache_config, cache_options, coarse_options, memory_report, verbose);
+        break;
+      default:
+        UTIL_THROW(util::Exception, "Unrecognized kenlm model type " << model_type);
     }
-    util::PrintUsage(std::cerr);
   } catch (const std::exception &e) {
     std::cerr << e.what() << std::endl;
     return 1;
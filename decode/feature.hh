@@ -8,6 +8,7 @@
 
 #include <cstddef>
 #include <string>
+#include <vector>
 
 namespace decode {
 
@@ -77,12 +78,31 @@ class Feature {
 
     virtual std::size_t DenseFeatureCount() const = 0;
 
+    /** were the weights already applied to the values in the phrase table?
+     * Then every weight of this feature is taken to be 1. */
+    virtual bool WeightsFolded() const { return false; }
+
+    /** the weights that were folded, or empty if the table did not record
+     * them. */
+    virtual std::vector<float> FoldedWeights() const { return std::vector<float>(); }
+
     virtual std::string FeatureDescription(std::size_t index) const = 0;
 };
 
 class ObjectiveBypass {
   public:
     virtual void InitTargetPhrase(TargetPhraseInfo target, lm::ngram::ChartState &state) const = 0;
+
+    /** InitTargetPhrase for all target phrases of a span, setting states[i]
+     * for targets[i].  Overrides may share work between the phrases but must
+     * give the same states. */
+    virtual void InitTargetPhrases(const std::vector<TargetPhraseInfo> &targets, std::vector<lm::ngram::ChartState> &states) const {
+      states.resize(targets.size());
+      for (std::size_t i = 0; i < targets.size(); ++i) {
+        InitTargetPhrase(targets[i], states[i]);
+      }
+    }
+
     virtual void SetSearchScore(Hypothesis *new_hypothesis, float score) const = 0;
 };
 
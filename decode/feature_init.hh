@@ -1,6 +1,7 @@
 #pragma once
 
 #include "decode/hypothesis.hh"
+#include "decode/lm_state_table.hh"
 #include "lm/state.hh"
 #include "pt/access.hh"
 #include "util/layout.hh"
@@ -20,7 +21,7 @@ struct FeatureInit {
   explicit FeatureInit(const pt::Access &phrase_accessor) :
     phrase_access(phrase_accessor),
     hypothesis_field(hypothesis_layout),
-    lm_state_field(hypothesis_layout),
+    lm_state_id_field(hypothesis_layout),
     pt_id_field(word_layout),
     pt_row_field(target_phrase_layout),
     phrase_score_field(target_phrase_layout) {}
@@ -37,7 +38,8 @@ struct FeatureInit {
     */
   util::Layout hypothesis_layout;
   const util::PODField<Hypothesis> hypothesis_field; // has to be first field
-  const util::PODField<LMState> lm_state_field;
+  // Language model state, interned in the sentence's LMStateTable.
+  const util::PODField<LMStateTable::ID> lm_state_id_field;
 
   /** Use to store information about the target phrase when scoring in
     * isolation (ScorePhrase). */
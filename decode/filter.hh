@@ -26,8 +26,11 @@ namespace decode {
     Filter(const std::string& file, util::MutableVocab& vocab, const std::size_t ngram_length = 3);
     bool PassesFilter(Phrase const& phrase) const;
 
-  private:
     typedef boost::unordered_set<Phrase> Map;
+    // Every n-gram of the source file up to ngram_length words long.
+    const Map& NGrams() const { return ngram_map_; }
+
+  private:
     Map ngram_map_;
     std::size_t ngram_length_;
 
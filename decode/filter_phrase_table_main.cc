@@ -0,0 +1,61 @@
+#include "decode/filter_table.hh"
+#include "util/exception.hh"
+#include "util/file.hh"
+
+#include <boost/program_options.hpp>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+int main(int argc, char *argv[]) {
+  try {
+    namespace po = boost::program_options;
+    po::options_description options("Phrase table filtering options");
+    std::string phrase_file, source_file;
+    std::size_t max_length;
+    std::vector<std::string> default_columns = {
+      "source",
+      "target",
+      "dense_features",
+      "sparse_features",
+      "lexical_reordering",
+    };
+    options.add_options()
+      ("help,h", po::bool_switch(), "Show this help message")
+      ("phrase,p", po::value<std::string>(&phrase_file)->required(), "Phrase table to filter, binary or text")
+      ("source,s", po::value<std::string>(&source_file)->required(), "Source text that will be decoded")
+      ("max-length,n", po::value<std::size_t>(&max_length)->default_value(0), "Keep source phrases of at most this many words that occur in the source text.  0 means the longest source phrase in the table.")
+      ("columns,c", po::value<std::vector<std::string> >()->multitoken()->default_value(default_columns, "source target dense_features sparse_features lexical_reordering"), "Columns in a text phrase table, as for binarize_phrase_table");
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, options), vm);
+
+    bool stdout_is_sizable = true;
+    try {
+      util::SizeOrThrow(1);
+    } catch (const util::FDException &) {
+      stdout_is_sizable = false;
+    }
+
+    if (argc == 1 || vm["help"].as<bool>() || !stdout_is_sizable) {
+      std::cerr <<
+        "Keeps the phrase table rows whose source phrase occurs in a source text and\n"
+        "writes them to a compact mtplz binary with only the words they use.\n"
+        "Usage: " << argv[0] << " -p pt -s source.txt >pt.binary\n"
+        "Where pt.binary must be a regular file.\n"
+        << options << std::endl;
+      return 1;
+    }
+    po::notify(vm);
+
+    if (decode::IsBinaryTable(phrase_file)) {
+      decode::FilterBinary(phrase_file, source_file, max_length, 1);
+    } else {
+      decode::FilterText(phrase_file, vm["columns"].as<std::vector<std::string> >(), source_file, max_length, 1);
+    }
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
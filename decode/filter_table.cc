@@ -0,0 +1,143 @@
+#include "decode/filter_table.hh"
+
+#include "decode/filter.hh"
+#include "pt/create.hh"
+#include "pt/format.hh"
+#include "pt/hash.hh"
+#include "pt/query.hh"
+#include "pt/statistics.hh"
+#include "util/exception.hh"
+#include "util/file.hh"
+#include "util/file_piece.hh"
+#include "util/mutable_vocab.hh"
+#include "util/tokenize_piece.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+namespace decode {
+namespace {
+
+// Maps word ids of the input table to the output table's compacted ids.
+class Remap {
+  public:
+    Remap(const util::MutableVocab &vocab, pt::TableWriter &writer)
+      : vocab_(vocab), writer_(writer), map_(vocab.Size(), kUnset) {}
+
+    pt::WordIndex operator()(pt::WordIndex from) {
+      pt::WordIndex &to = map_[from];
+      if (to == kUnset) to = writer_.FindOrInsert(vocab_.String(from));
+      return to;
+    }
+
+  private:
+    static const pt::WordIndex kUnset = std::numeric_limits<pt::WordIndex>::max();
+
+    const util::MutableVocab &vocab_;
+    pt::TableWriter &writer_;
+    std::vector<pt::WordIndex> map_;
+};
+
+StringPiece SourceColumn(StringPiece line, const pt::TextColumns &columns) {
+  util::TokenIter<util::MultiCharacter> column(line, "|||");
+  for (std::size_t i = 0; i < columns.source; ++i, ++column) {
+    UTIL_THROW_IF2(!column, "No source column in line " << line);
+  }
+  UTIL_THROW_IF2(!column, "No source column in line " << line);
+  return *column;
+}
+
+} // namespace
+
+bool IsBinaryTable(const std::string &file) {
+  util::scoped_fd fd(util::OpenReadOrThrow(file.c_str()));
+  std::string buf(std::strlen(pt::kFileHeader), 0);
+  return util::ReadOrEOF(fd.get(), &buf[0], buf.size()) == buf.size() && buf == pt::kFileHeader;
+}
+
+// Look up every phrase of the source text in a binary table and copy the rows
+// found.  Only words that appear in copied phrases enter the new vocabulary.
+void FilterBinary(const std::string &in, const std::string &source_text, std::size_t max_length, int out) {
+  pt::Table table(in.c_str(), util::LAZY);
+  // Ids in vocab match the table's for the table's words.
+  util::MutableVocab vocab;
+  pt::VocabRange table_vocab(table.Vocab());
+  pt::VocabRange::Iterator word = table_vocab.begin();
+  for (++word /* <unk> is already present */; word; ++word) {
+    vocab.FindOrInsert(*word);
+  }
+  const std::size_t table_vocab_size = vocab.Size();
+  if (!max_length) max_length = table.Stats().max_source_phrase_length;
+  Filter filter(source_text, vocab, max_length);
+
+  pt::TableWriter writer(out, table.Config());
+  Remap remap(vocab, writer);
+  const pt::Access &from_access = table.Accessor();
+  const pt::Access &to_access = writer.Accessor();
+  std::vector<pt::WordIndex> source;
+  for (Filter::Map::const_iterator phrase = filter.NGrams().begin(); phrase != filter.NGrams().end(); ++phrase) {
+    bool known = true;
+    for (Phrase::const_iterator i = phrase->begin(); i != phrase->end(); ++i) {
+      known &= (*i < table_vocab_size);
+    }
+    if (!known) continue;
+    boost::iterator_range<pt::RowIterator> rows(table.Lookup(&*phrase->begin(), &*phrase->begin() + phrase->size()));
+    if (rows.empty()) continue;
+    source.clear();
+    for (Phrase::const_iterator i = phrase->begin(); i != phrase->end(); ++i) {
+      source.push_back(remap(*i));
+    }
+    writer.StartSource(pt::HashSource(&*source.begin(), &*source.begin() + source.size()), source.size());
+    pt::TargetBundleWriter bundle(writer.Targets());
+    for (pt::RowIterator row = rows.begin(); row != rows.end(); ++row) {
+      // Fields are the same so the row is copied whole, then its target renumbered.
+      const char *row_begin = reinterpret_cast<const char*>(static_cast<const pt::Row*>(row));
+      std::size_t size = reinterpret_cast<const char*>(from_access.End(row)) - row_begin;
+      pt::Row *copy = static_cast<pt::Row*>(bundle.Allocate(size));
+      std::memcpy(copy, row_begin, size);
+      for (pt::WordIndex *w = to_access.target(copy).begin(); w != to_access.target(copy).end(); ++w) {
+        *w = remap(*w);
+      }
+    }
+  }
+  writer.Finish();
+}
+
+// Keep lines of a text table whose source phrase occurs in the source text,
+// then binarize them.  Finding the longest source phrase takes another pass.
+void FilterText(const std::string &in, const std::vector<std::string> &column_names, const std::string &source_text, std::size_t max_length, int out) {
+  pt::TextColumns columns;
+  pt::FieldConfig fields;
+  pt::BindColumns(column_names, columns, fields);
+  if (!max_length) {
+    util::FilePiece f(in.c_str(), &std::cerr);
+    for (util::LineIterator line = f.begin(); line; ++line) {
+      std::size_t length = 0;
+      for (util::TokenIter<util::BoolCharacter, true> word(SourceColumn(*line, columns), util::kSpaces); word; ++word) {
+        ++length;
+      }
+      max_length = std::max(max_length, length);
+    }
+  }
+  util::MutableVocab vocab;
+  Filter filter(source_text, vocab, max_length);
+
+  util::scoped_fd kept(util::MakeTemp(util::DefaultTempDirectory()));
+  util::FilePiece f(in.c_str(), &std::cerr);
+  Phrase source;
+  for (util::LineIterator line = f.begin(); line; ++line) {
+    source.clear();
+    for (util::TokenIter<util::BoolCharacter, true> word(SourceColumn(*line, columns), util::kSpaces); word; ++word) {
+      source.push_back(vocab.FindOrInsert(*word));
+    }
+    if (!filter.NGrams().count(source)) continue;
+    util::WriteOrThrow(kept.get(), line->data(), line->size());
+    util::WriteOrThrow(kept.get(), "\n", 1);
+  }
+  util::SeekOrThrow(kept.get(), 0);
+  pt::CreateTable(kept.release(), out, columns, fields);
+}
+
+} // namespace decode
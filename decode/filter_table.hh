@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <stddef.h>
+
+namespace decode {
+
+// Whether the file starts with the header of an mtplz binary phrase table.
+bool IsBinaryTable(const std::string &file);
+
+/* Write a binary phrase table to out with the rows of in whose source phrase
+ * occurs in source_text and has at most max_length words, or any length if
+ * max_length is 0.  Only words that appear in kept rows are in the new
+ * vocabulary.  out must be a regular file.
+ */
+
+// in is a binary table; the rows are copied as they are.
+void FilterBinary(const std::string &in, const std::string &source_text, std::size_t max_length, int out);
+
+// in is a text table with columns named as for binarize_phrase_table.
+void FilterText(const std::string &in, const std::vector<std::string> &column_names, const std::string &source_text, std::size_t max_length, int out);
+
+} // namespace decode
@@ -0,0 +1,196 @@
+#include "decode/filter_table.hh"
+
+#include "pt/create.hh"
+#include "pt/query.hh"
+#include "util/file.hh"
+#include "util/tokenize_piece.hh"
+
+#define BOOST_TEST_MODULE FilterTableTest
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+
+namespace decode {
+namespace {
+
+const char *PhraseTableLocation() {
+  if (boost::unit_test::framework::master_test_suite().argc < 2) {
+    return "test.phrase_table";
+  }
+  return boost::unit_test::framework::master_test_suite().argv[1];
+}
+
+const char *SourceTextLocation() {
+  if (boost::unit_test::framework::master_test_suite().argc < 3) {
+    return "test.source_text";
+  }
+  return boost::unit_test::framework::master_test_suite().argv[2];
+}
+
+std::vector<std::string> Columns() {
+  return {"source", "target", "dense_features", "lexical_reordering"};
+}
+
+// Named temporary file, removed on destruction.
+class TempFile {
+  public:
+    TempFile() : name_(util::DefaultTempDirectory() + "filter_table_test_XXXXXX") {
+      util::scoped_fd fd(mkstemp(&name_[0]));
+      BOOST_REQUIRE(fd.get() != -1);
+    }
+
+    explicit TempFile(const std::string &contents) : TempFile() {
+      util::scoped_fd fd(util::CreateOrThrow(name_.c_str()));
+      util::WriteOrThrow(fd.get(), contents.data(), contents.size());
+    }
+
+    ~TempFile() { std::remove(name_.c_str()); }
+
+    const std::string &Name() const { return name_; }
+
+  private:
+    std::string name_;
+};
+
+void Binarize(const std::string &text, const TempFile &to) {
+  pt::TextColumns columns;
+  pt::FieldConfig fields;
+  pt::BindColumns(Columns(), columns, fields);
+  pt::CreateTable(util::OpenReadOrThrow(text.c_str()), util::CreateOrThrow(to.Name().c_str()), columns, fields);
+}
+
+// Filter the text table and its binary to from_binary and from_text.
+void FilterBoth(const std::string &text, const std::string &source_text, std::size_t max_length, const TempFile &from_binary, const TempFile &from_text) {
+  TempFile binary;
+  Binarize(text, binary);
+  FilterBinary(binary.Name(), source_text, max_length, util::CreateOrThrow(from_binary.Name().c_str()));
+  FilterText(text, Columns(), source_text, max_length, util::CreateOrThrow(from_text.Name().c_str()));
+}
+
+// A filtered table as strings.
+struct Filtered {
+  explicit Filtered(const std::string &file) : table(file.c_str(), util::READ) {
+    pt::VocabRange range(table.Vocab());
+    for (pt::VocabRange::Iterator word = range.begin(); word; ++word) {
+      vocab.push_back(word->as_string());
+    }
+  }
+
+  // Targets of the source phrase in table order, or none if a word of it is
+  // not in the vocabulary.
+  std::vector<std::string> Targets(StringPiece source) const {
+    std::vector<pt::WordIndex> ids;
+    for (util::TokenIter<util::SingleCharacter, true> word(source, ' '); word; ++word) {
+      std::vector<std::string>::const_iterator found = std::find(vocab.begin(), vocab.end(), *word);
+      if (found == vocab.end()) return std::vector<std::string>();
+      ids.push_back(found - vocab.begin());
+    }
+    std::vector<std::string> ret;
+    boost::iterator_range<pt::RowIterator> rows(table.Lookup(&*ids.begin(), &*ids.begin() + ids.size()));
+    for (pt::RowIterator row = rows.begin(); row != rows.end(); ++row) {
+      std::string target;
+      for (const pt::WordIndex *w = row.Accessor().target(row).begin(); w != row.Accessor().target(row).end(); ++w) {
+        if (!target.empty()) target += ' ';
+        target += vocab[*w];
+      }
+      ret.push_back(target);
+    }
+    return ret;
+  }
+
+  std::set<std::string> Words() const {
+    return std::set<std::string>(vocab.begin(), vocab.end());
+  }
+
+  pt::Table table;
+  std::vector<std::string> vocab;
+};
+
+std::vector<std::string> Strings(const char *first, const char *second = NULL) {
+  std::vector<std::string> ret(1, first);
+  if (second) ret.push_back(second);
+  return ret;
+}
+
+std::set<std::string> WordSet(const char *words) {
+  std::set<std::string> ret = {"<unk>", "<s>", "</s>"};
+  for (util::TokenIter<util::SingleCharacter, true> word(words, ' '); word; ++word) {
+    ret.insert(word->as_string());
+  }
+  return ret;
+}
+
+// Filter the test table against source_text on the binary and text paths,
+// which should agree.
+void CheckBoth(const std::string &source_text, std::size_t max_length, const std::vector<std::string> &abc, const std::vector<std::string> &de, const std::set<std::string> &words) {
+  TempFile from_binary, from_text;
+  FilterBoth(PhraseTableLocation(), source_text, max_length, from_binary, from_text);
+  const std::string *names[2] = {&from_binary.Name(), &from_text.Name()};
+  for (std::size_t i = 0; i < 2; ++i) {
+    Filtered filtered(*names[i]);
+    std::vector<std::string> targets = filtered.Targets("a b c");
+    BOOST_CHECK_EQUAL_COLLECTIONS(abc.begin(), abc.end(), targets.begin(), targets.end());
+    targets = filtered.Targets("d e");
+    BOOST_CHECK_EQUAL_COLLECTIONS(de.begin(), de.end(), targets.begin(), targets.end());
+    std::set<std::string> actual(filtered.Words());
+    BOOST_CHECK_EQUAL_COLLECTIONS(words.begin(), words.end(), actual.begin(), actual.end());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(IsBinary) {
+  TempFile binary;
+  Binarize(PhraseTableLocation(), binary);
+  BOOST_CHECK(IsBinaryTable(binary.Name()));
+  BOOST_CHECK(!IsBinaryTable(PhraseTableLocation()));
+}
+
+BOOST_AUTO_TEST_CASE(SourceText) {
+  // Both source phrases occur.
+  CheckBoth(SourceTextLocation(), 0, Strings("B A C", "B A"), Strings("D E F"), WordSet("a b c B A C d e D E F"));
+}
+
+BOOST_AUTO_TEST_CASE(Compact) {
+  // Only a b c occurs, so d e and its words are gone.
+  TempFile source("x a b c y\n");
+  CheckBoth(source.Name(), 0, Strings("B A C", "B A"), std::vector<std::string>(), WordSet("a b c B A C"));
+}
+
+BOOST_AUTO_TEST_CASE(Exact) {
+  // Every word of a b c occurs but not the phrase.
+  TempFile source("a b\nb c d e\n");
+  CheckBoth(source.Name(), 0, std::vector<std::string>(), Strings("D E F"), WordSet("d e D E F"));
+}
+
+BOOST_AUTO_TEST_CASE(MaxLength) {
+  TempFile source("a b c d e\n");
+  CheckBoth(source.Name(), 2, std::vector<std::string>(), Strings("D E F"), WordSet("d e D E F"));
+}
+
+BOOST_AUTO_TEST_CASE(LongPhrase) {
+  // Both 7-grams of the phrase occur in the source text but the phrase does
+  // not, so it is dropped by default.
+  TempFile text(
+      "a b c d e f g h ||| X ||| 1 1 1 1 1 ||| 1 1 1 1 1 1\n"
+      "b c ||| Y ||| 1 1 1 1 1 ||| 1 1 1 1 1 1\n");
+  TempFile source("a b c d e f g\nb c d e f g h\n");
+  TempFile from_binary, from_text;
+  FilterBoth(text.Name(), source.Name(), 0, from_binary, from_text);
+  const std::string *names[2] = {&from_binary.Name(), &from_text.Name()};
+  for (std::size_t i = 0; i < 2; ++i) {
+    Filtered filtered(*names[i]);
+    BOOST_CHECK(filtered.Targets("a b c d e f g h").empty());
+    std::vector<std::string> expected(Strings("Y")), targets(filtered.Targets("b c"));
+    BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(), targets.begin(), targets.end());
+    std::set<std::string> words(WordSet("b c Y")), actual(filtered.Words());
+    BOOST_CHECK_EQUAL_COLLECTIONS(words.begin(), words.end(), actual.begin(), actual.end());
+  }
+}
+
+} // namespace
+} // namespace decode
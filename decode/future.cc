@@ -8,9 +8,10 @@
 
 namespace decode {
 
-Future::Future(const Chart &chart)
+Future::Future(const Chart &chart, float distortion_weight)
   : sentence_length_plus_1_(chart.SentenceLength() + 1),
-    entries_(sentence_length_plus_1_ * sentence_length_plus_1_, -INFINITY) {
+    entries_(sentence_length_plus_1_ * sentence_length_plus_1_, -INFINITY),
+    distortion_weight_(distortion_weight) {
 
   for (std::size_t begin = 0; begin <= chart.SentenceLength(); ++begin) {
     // Nothing is nothing (this is a useful concept when two phrases abut)
@@ -16,20 +16,48 @@ class Chart;
 
 class Future {
   public:
-    explicit Future(const Chart &chart);
+    // A non-zero distortion_weight adds the distortion that a hypothesis with
+    // uncovered gaps must still pay to the estimate.
+    explicit Future(const Chart &chart, float distortion_weight = 0.0);
 
     float Full() const {
       return Entry(0, sentence_length_plus_1_ - 1);
     }
 
-    // Calculate change in rest cost when the given coverage is to be covered.
-    float Change(const Coverage &coverage, std::size_t begin, std::size_t end) {
+    // Calculate change in rest cost when [begin, end) is covered by a
+    // hypothesis with the given coverage whose last phrase ended at last_end.
+    float Change(const Coverage &coverage, std::size_t last_end, std::size_t begin, std::size_t end) const {
       std::size_t left = coverage.LeftOpen(begin);
       std::size_t right = coverage.RightOpen(end, sentence_length_plus_1_ - 1);
-      return Entry(left, begin) + Entry(end, right) - Entry(left, right);
+      float ret = Entry(left, begin) + Entry(end, right) - Entry(left, right);
+      if (distortion_weight_ != 0.0) {
+        // The first gap only moves if this phrase starts there.  Then it
+        // moves to end unless end is already covered, i.e. the phrase fills
+        // the whole gap [left, right).
+        std::size_t first_zero = coverage.FirstZero();
+        if (begin == first_zero) {
+          if (end < right || end == sentence_length_plus_1_ - 1) {
+            first_zero = end;
+          } else {
+            Coverage after(coverage);
+            after.Set(begin, end);
+            first_zero = after.FirstZero();
+          }
+        }
+        ret += distortion_weight_ * (
+            static_cast<float>(MinimumDistortion(first_zero, end)) -
+            static_cast<float>(MinimumDistortion(coverage.FirstZero(), last_end)));
+      }
+      return ret;
     }
 
   private:
+    // A hypothesis ending at last_end with a gap starting at first_zero must
+    // jump back at least this far before it can complete.
+    static std::size_t MinimumDistortion(std::size_t first_zero, std::size_t last_end) {
+      return (first_zero < last_end) ? (last_end - first_zero) : 0;
+    }
+
     float Entry(std::size_t begin, std::size_t end) const {
       assert(end >= begin);
       assert(end < sentence_length_plus_1_);
@@ -47,6 +75,8 @@ class Future {
 
     // Square matrix with half the values ignored.  TODO: waste less memory.
     std::vector<float> entries_;
+
+    float distortion_weight_;
 };
 
 } // namespace decode
@@ -0,0 +1,207 @@
+#include "decode/future.hh"
+
+#include "decode/chart.hh"
+#include "decode/system.hh"
+#include "pt/access.hh"
+
+#define BOOST_TEST_MODULE FutureTest
+#include <boost/test/unit_test.hpp>
+
+#include <boost/scoped_ptr.hpp>
+
+#include <string.h>
+
+namespace decode {
+namespace {
+
+// Scores a target phrase by where its row is in rows.
+class FeatureMock : public Feature, public ObjectiveBypass {
+  public:
+    FeatureMock(const FeatureInit &init, const char *rows) : Feature("mock"), init_(init), rows_(rows) {}
+
+    void Init(FeatureInit &feature_init) override {}
+    void NewWord(const StringPiece string_rep, VocabWord *word) const override {}
+    void InitPassthroughPhrase(pt::Row *passthrough, TargetPhraseType type) const override {}
+    void ScoreTargetPhrase(TargetPhraseInfo target, ScoreCollector &collector) const override {
+      const char *row = reinterpret_cast<const char*>(init_.pt_row_field(target.phrase));
+      collector.AddDense(0, -static_cast<float>(row - rows_));
+    }
+    void ScoreHypothesisWithSourcePhrase(
+        const Hypothesis &hypothesis, const SourcePhrase source_phrase, ScoreCollector &collector) const override {}
+    void ScoreHypothesisWithPhrasePair(
+        const Hypothesis &hypothesis, PhrasePair phrase_pair, ScoreCollector &collector) const override {}
+    void ScoreFinalHypothesis(
+        const Hypothesis &hypothesis, ScoreCollector &collector) const override {}
+    bool HypothesisEqual(const Hypothesis &first, const Hypothesis &second) const override { return true; }
+    std::size_t DenseFeatureCount() const override { return 1; }
+    std::string FeatureDescription(std::size_t index) const override { return ""; }
+    void InitTargetPhrase(TargetPhraseInfo target, lm::ngram::ChartState &state) const override {
+      memset(&state, 0, sizeof(state));
+    }
+    void SetSearchScore(Hypothesis *new_hypo, float score) const override {}
+
+  private:
+    const FeatureInit &init_;
+    const char *rows_;
+};
+
+// Phrase table with one to three rows, which are bytes of rows_, for every
+// source phrase.
+class TableMock {
+  public:
+    class Iterator {
+      public:
+        explicit Iterator(const char *at) : at_(at) {}
+        const pt::Row &operator*() const { return *reinterpret_cast<const pt::Row*>(at_); }
+        Iterator &operator++() { ++at_; return *this; }
+        bool operator!=(const Iterator &other) const { return at_ != other.at_; }
+      private:
+        const char *at_;
+    };
+
+    struct Rows {
+      Iterator begin() const { return Iterator(begin_); }
+      Iterator end() const { return Iterator(end_); }
+      bool operator!() const { return begin_ == end_; }
+      const char *begin_, *end_;
+    };
+
+    explicit TableMock(const char *rows) : rows_(rows) {}
+
+    Rows Lookup(const ID *begin, const ID *end) const {
+      std::size_t hash = end - begin;
+      for (const ID *i = begin; i != end; ++i) hash = hash * 31 + *i;
+      Rows ret;
+      ret.begin_ = rows_ + hash % 40;
+      ret.end_ = ret.begin_ + 1 + hash % 3;
+      return ret;
+    }
+
+  private:
+    const char *rows_;
+};
+
+const float kDistortionWeight = -0.5;
+
+// A chart of a five-word sentence and its future costs with and without
+// distortion.
+struct ChartFixture {
+  ChartFixture()
+    : objective(access, lm_state),
+      feature(objective.GetFeatureInit(), rows),
+      table(rows),
+      workers(1) {
+    objective.AddFeature(feature);
+    objective.RegisterLanguageModel(feature);
+    objective.weights.push_back(1.0);
+    const char *words[] = {"a", "b", "c", "d", "e"};
+    for (std::size_t i = 0; i < 5; ++i) base_vocab.vocab.FindOrInsert(words[i]);
+    util::Layout &word_layout = objective.GetFeatureInit().word_layout;
+    while (base_vocab.map.size() < base_vocab.vocab.Size()) {
+      base_vocab.map.push_back(reinterpret_cast<VocabWord*>(word_layout.Allocate(base_vocab.pool)));
+    }
+    chart.reset(new Chart(3, base_vocab, objective, cache));
+    chart->ReadSentence("a b c d e");
+    chart->LoadPhrases(table, workers, 1);
+    future.reset(new Future(*chart));
+    distortion.reset(new Future(*chart, kDistortionWeight));
+  }
+
+  // Distortion part of the change.
+  float DistortionChange(const Coverage &coverage, std::size_t last_end, std::size_t begin, std::size_t end) const {
+    return distortion->Change(coverage, last_end, begin, end) - future->Change(coverage, last_end, begin, end);
+  }
+
+  pt::FieldConfig config;
+  pt::Access access{config};
+  lm::ngram::State lm_state;
+  Objective objective;
+  char rows[64];
+  FeatureMock feature;
+  BaseVocab base_vocab;
+  TableMock table;
+  Workers workers;
+  Chart::VertexCache cache;
+  boost::scoped_ptr<Chart> chart;
+  boost::scoped_ptr<Future> future, distortion;
+};
+
+BOOST_FIXTURE_TEST_SUITE(suite, ChartFixture)
+
+BOOST_AUTO_TEST_CASE(OutOfOrder) {
+  BOOST_CHECK_EQUAL(future->Full(), distortion->Full());
+  float estimate = future->Full(), owed = 0.0;
+  Coverage coverage;
+
+  // Jumping ahead leaves [0, 2) behind, so the hypothesis owes the jump back.
+  owed += DistortionChange(coverage, 0, 2, 4);
+  BOOST_CHECK_CLOSE(kDistortionWeight * 4, owed, 0.001);
+  estimate += future->Change(coverage, 0, 2, 4);
+  coverage.Set(2, 4);
+  BOOST_CHECK_EQUAL(0, coverage.FirstZero());
+
+  // Filling the gap moves the first zero past the covered [2, 4), which
+  // Change finds with Coverage::Set.
+  owed += DistortionChange(coverage, 4, 0, 2);
+  BOOST_CHECK_SMALL(owed, 0.001f);
+  estimate += future->Change(coverage, 4, 0, 2);
+  coverage.Set(0, 2);
+  BOOST_CHECK_EQUAL(4, coverage.FirstZero());
+
+  // Ending the sentence.
+  owed += DistortionChange(coverage, 2, 4, 5);
+  estimate += future->Change(coverage, 2, 4, 5);
+  coverage.Set(4, 5);
+  BOOST_CHECK_EQUAL(5, coverage.FirstZero());
+
+  // Once everything is covered, nothing is owed and nothing is left.
+  BOOST_CHECK_SMALL(owed, 0.001f);
+  BOOST_CHECK_SMALL(estimate, 0.001f);
+}
+
+BOOST_AUTO_TEST_CASE(GapInMiddle) {
+  float owed = 0.0;
+  Coverage coverage;
+  // In order to 1, then skip [1, 2).
+  owed += DistortionChange(coverage, 0, 0, 1);
+  BOOST_CHECK_SMALL(owed, 0.001f);
+  coverage.Set(0, 1);
+  owed += DistortionChange(coverage, 1, 2, 3);
+  BOOST_CHECK_CLOSE(kDistortionWeight * 2, owed, 0.001);
+  coverage.Set(2, 3);
+  // Covering past the gap owes more.
+  owed += DistortionChange(coverage, 3, 3, 5);
+  BOOST_CHECK_CLOSE(kDistortionWeight * 4, owed, 0.001);
+  coverage.Set(3, 5);
+  // Filling the gap, which is closed on the right by [2, 5), completes the
+  // sentence, so the last phrase ends at 2 but nothing more is owed.
+  owed += DistortionChange(coverage, 5, 1, 2);
+  coverage.Set(1, 2);
+  BOOST_CHECK_EQUAL(5, coverage.FirstZero());
+  BOOST_CHECK_SMALL(owed, 0.001f);
+}
+
+BOOST_AUTO_TEST_CASE(Monotone) {
+  const std::size_t length = chart->SentenceLength();
+  BOOST_CHECK_SMALL(future->Change(Coverage(), 0, 0, length) + future->Full(), 0.001f);
+  for (std::size_t begin = 0; begin < length; ++begin) {
+    // Without reordering, coverage is exactly [0, begin).
+    Coverage coverage;
+    if (begin) coverage.Set(0, begin);
+    for (std::size_t end = begin + 1; end <= length; ++end) {
+      // Covering the span and then the rest changes as much as covering
+      // [begin, length) at once.
+      Coverage after(coverage);
+      after.Set(begin, end);
+      const float rest = (end == length) ? 0.0 : future->Change(after, end, end, length);
+      BOOST_CHECK_SMALL(future->Change(coverage, begin, begin, end) + rest - future->Change(coverage, begin, begin, length), 0.001f);
+      // There is no gap, so no distortion is owed.
+      BOOST_CHECK_EQUAL(0.0, DistortionChange(coverage, begin, begin, end));
+    }
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace
+} // namespace decode
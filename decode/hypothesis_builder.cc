@@ -8,7 +8,7 @@ Hypothesis *HypothesisBuilder::BuildHypothesis(
   feature_init_.pt_row_field(target_phrase) = target;
   void *hypo = feature_init_.hypothesis_layout.Allocate(pool_);
   feature_init_.hypothesis_field(hypo) = Hypothesis(score, target_phrase);
-  feature_init_.lm_state_field(hypo) = state;
+  feature_init_.lm_state_id_field(hypo) = lm_states_.Intern(state);
   return reinterpret_cast<Hypothesis*>(hypo);
 }
 
@@ -21,7 +21,7 @@ Hypothesis *HypothesisBuilder::BuildHypothesis(
     std::size_t source_end,
     const TargetPhrase *target) {
   feature_init_.hypothesis_field(base) = Hypothesis(score, previous, source_begin, source_end, target);
-  feature_init_.lm_state_field(base) = state;
+  feature_init_.lm_state_id_field(base) = lm_states_.Intern(state);
   return base;
 }
 
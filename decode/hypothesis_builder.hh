@@ -12,8 +12,8 @@ namespace decode {
  */
 class HypothesisBuilder {
   public:
-    HypothesisBuilder(util::Pool &pool, FeatureInit &feature_init)
-      : pool_(pool), feature_init_(feature_init) {}
+    HypothesisBuilder(util::Pool &pool, FeatureInit &feature_init, LMStateTable &lm_states)
+      : pool_(pool), feature_init_(feature_init), lm_states_(lm_states) {}
 
     /** Build root hypothesis */
     Hypothesis *BuildHypothesis(
@@ -45,6 +45,8 @@ class HypothesisBuilder {
     FeatureInit &feature_init_;
 
     util::Pool &pool_;
+
+    LMStateTable &lm_states_;
 };
 
 } // namespace decode
@@ -40,6 +40,12 @@ class LexicalizedReordering : public Feature {
 
     std::size_t DenseFeatureCount() const override { return 6; }
 
+    bool WeightsFolded() const override { return phrase_access_->weights_folded; }
+
+    std::vector<float> FoldedWeights() const override {
+      return phrase_access_->folded_lexical_reordering_weights;
+    }
+
     std::string FeatureDescription(std::size_t index) const override;
   private:
     Relation PhraseRelation(SourceSpan phrase1, SourceSpan phrase2) const;
@@ -2,15 +2,16 @@
 
 #include "decode/vocab_map.hh"
 #include "lm/left.hh"
+#include "lm/terminal_batch.hh"
 #include "util/mutable_vocab.hh"
 #include "util/exception.hh"
 
 namespace decode {
 
-LM::LM(const char *model) :
-  Feature("lm"), model_(model) {}
+template <class Model> LM<Model>::LM(const char *model, std::size_t prefetch_group) :
+  Feature("lm"), model_(model), prefetch_group_(prefetch_group) {}
 
-void LM::Init(FeatureInit &feature_init) {
+template <class Model> void LM<Model>::Init(FeatureInit &feature_init) {
   pt_row_field_ = feature_init.pt_row_field;
   UTIL_THROW_IF(!feature_init.phrase_access.target, util::Exception,
       "requested language model but target phrase text is missing in phrase access");
@@ -20,16 +21,16 @@ void LM::Init(FeatureInit &feature_init) {
   hypothesis_with_phrase_pair_score_ = util::PODField<float>(feature_init.hypothesis_layout);
 }
 
-void LM::NewWord(const StringPiece string_rep, VocabWord *word) const {
+template <class Model> void LM<Model>::NewWord(const StringPiece string_rep, VocabWord *word) const {
   lm_word_index_(word) = model_.GetVocabulary().Index(string_rep);
 }
 
-void LM::ScoreTargetPhrase(TargetPhraseInfo target, ScoreCollector &collector) const {
+template <class Model> void LM<Model>::ScoreTargetPhrase(TargetPhraseInfo target, ScoreCollector &collector) const {
   collector.AddDense(0, phrase_score_field_(target.phrase));
 }
 
-void LM::InitTargetPhrase(TargetPhraseInfo target, lm::ngram::ChartState &state) const {
-  lm::ngram::RuleScore<lm::ngram::Model> scorer(model_, state);
+template <class Model> void LM<Model>::InitTargetPhrase(TargetPhraseInfo target, lm::ngram::ChartState &state) const {
+  lm::ngram::RuleScore<Model> scorer(model_, state);
   const pt::Row *pt_target_phrase = pt_row_field_(target.phrase);
   for (const ID i : phrase_access_->target(pt_target_phrase)) {
     scorer.Terminal(lm_word_index_(target.vocab_map.Find(i)));
@@ -37,21 +38,47 @@ void LM::InitTargetPhrase(TargetPhraseInfo target, lm::ngram::ChartState &state)
   phrase_score_field_(target.phrase) = scorer.Finish();
 }
 
-void LM::SetSearchScore(Hypothesis *new_hypothesis, float score) const {
+template <class Model> void LM<Model>::InitTargetPhrases(const std::vector<TargetPhraseInfo> &targets, std::vector<lm::ngram::ChartState> &states) const {
+  lm::ngram::TerminalBatch<Model> batch(model_, prefetch_group_);
+  std::vector<lm::WordIndex> words;
+  for (const TargetPhraseInfo &target : targets) {
+    words.clear();
+    for (const ID i : phrase_access_->target(pt_row_field_(target.phrase))) {
+      words.push_back(lm_word_index_(target.vocab_map.Find(i)));
+    }
+    batch.Add(words.data(), words.data() + words.size());
+  }
+  states.resize(targets.size());
+  std::vector<float> scores(targets.size());
+  if (targets.empty()) return;
+  batch.Finish(&states[0], &scores[0]);
+  for (std::size_t i = 0; i < targets.size(); ++i) {
+    phrase_score_field_(targets[i].phrase) = scores[i];
+  }
+}
+
+template <class Model> void LM<Model>::SetSearchScore(Hypothesis *new_hypothesis, float score) const {
   hypothesis_with_phrase_pair_score_(new_hypothesis) = score;
 }
 
-void LM::ScoreHypothesisWithPhrasePair(
+template <class Model> void LM<Model>::ScoreHypothesisWithPhrasePair(
         const Hypothesis &hypothesis, PhrasePair phrase_pair, ScoreCollector &collector) const {
   float score = hypothesis_with_phrase_pair_score_(collector.NewHypothesis());
   collector.AddDense(0, score);
 }
 
-std::size_t LM::DenseFeatureCount() const { return 1; }
+template <class Model> std::size_t LM<Model>::DenseFeatureCount() const { return 1; }
 
-std::string LM::FeatureDescription(std::size_t index) const {
+template <class Model> std::string LM<Model>::FeatureDescription(std::size_t index) const {
   assert(index == 0);
   return "lm";
 }
 
+template class LM<lm::ngram::ProbingModel>;
+template class LM<lm::ngram::RestProbingModel>;
+template class LM<lm::ngram::TrieModel>;
+template class LM<lm::ngram::QuantTrieModel>;
+template class LM<lm::ngram::ArrayTrieModel>;
+template class LM<lm::ngram::QuantArrayTrieModel>;
+
 } // namespace decode
@@ -9,9 +9,12 @@ namespace util { class MutableVocab; }
 
 namespace decode {
 
-class LM : public Feature, public ObjectiveBypass {
+// Model is any of the lm::ngram model types; see the instantiations in lm.cc.
+template <class Model> class LM : public Feature, public ObjectiveBypass {
   public:
-    LM(const char *model);
+    // prefetch_group target phrase words are scored together after
+    // prefetching their entries; see lm::ngram::TerminalBatch.
+    explicit LM(const char *model, std::size_t prefetch_group = 1);
 
     void Init(FeatureInit &feature_init) override;
 
@@ -21,6 +24,8 @@ class LM : public Feature, public ObjectiveBypass {
 
     // from ObjectiveBypass
     void InitTargetPhrase(TargetPhraseInfo target, lm::ngram::ChartState &state) const override;
+    // Scores each shared prefix of the target phrases once.
+    void InitTargetPhrases(const std::vector<TargetPhraseInfo> &targets, std::vector<lm::ngram::ChartState> &states) const override;
     void SetSearchScore(Hypothesis *new_hypothesis, float score) const override;
 
     void ScoreTargetPhrase(TargetPhraseInfo target, ScoreCollector &collector) const override;
@@ -44,10 +49,11 @@ class LM : public Feature, public ObjectiveBypass {
 
     std::string FeatureDescription(std::size_t index) const override;
 
-    const lm::ngram::Model &Model() const { return model_; }
+    const Model &GetModel() const { return model_; }
 
   private:
-    lm::ngram::Model model_;
+    Model model_;
+    const std::size_t prefetch_group_;
     const pt::Access *phrase_access_;
     util::PODField<const pt::Row*> pt_row_field_;
     util::PODField<lm::WordIndex> lm_word_index_;
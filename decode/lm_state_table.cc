@@ -0,0 +1,19 @@
+#include "decode/lm_state_table.hh"
+
+namespace decode {
+
+LMStateTable::LMStateTable() : ids_(0, Hash(states_), Equal(states_)) {}
+
+LMStateTable::ID LMStateTable::Intern(const lm::ngram::Right &state) {
+  // Tentatively append so the set can compare against it.
+  ID id = states_.size();
+  states_.push_back(state);
+  std::pair<boost::unordered_set<ID, Hash, Equal>::iterator, bool> ret(ids_.insert(id));
+  if (!ret.second) {
+    states_.pop_back();
+    return *ret.first;
+  }
+  return id;
+}
+
+} // namespace decode
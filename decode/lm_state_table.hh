@@ -0,0 +1,54 @@
+#pragma once
+
+#include "lm/state.hh"
+
+#include <boost/unordered_set.hpp>
+
+#include <stdint.h>
+#include <vector>
+
+namespace decode {
+
+/* Interns language model states so that each hypothesis stores a 32-bit id
+ * instead of a whole lm::ngram::Right sized for KENLM_MAX_ORDER.  Equal
+ * states get equal ids, so recombination compares ids.  One table serves one
+ * sentence.
+ */
+class LMStateTable {
+  public:
+    typedef uint32_t ID;
+
+    LMStateTable();
+
+    ID Intern(const lm::ngram::Right &state);
+
+    // References are invalidated by Intern.
+    const lm::ngram::Right &operator[](ID id) const { return states_[id]; }
+
+    std::size_t Size() const { return states_.size(); }
+
+    // States and the index over them.
+    std::size_t MemoryBytes() const {
+      return states_.capacity() * sizeof(lm::ngram::Right)
+        + ids_.size() * (sizeof(ID) + sizeof(void*)) + ids_.bucket_count() * sizeof(void*);
+    }
+
+  private:
+    struct Hash : public std::unary_function<ID, std::size_t> {
+      explicit Hash(const std::vector<lm::ngram::Right> &states) : states_(&states) {}
+      std::size_t operator()(ID id) const { return hash_value((*states_)[id]); }
+      const std::vector<lm::ngram::Right> *states_;
+    };
+    struct Equal : public std::binary_function<ID, ID, bool> {
+      explicit Equal(const std::vector<lm::ngram::Right> &states) : states_(&states) {}
+      bool operator()(ID first, ID second) const { return (*states_)[first] == (*states_)[second]; }
+      const std::vector<lm::ngram::Right> *states_;
+    };
+
+    std::vector<lm::ngram::Right> states_;
+
+    // Ids of states_, found by the state they refer to.
+    boost::unordered_set<ID, Hash, Equal> ids_;
+};
+
+} // namespace decode
@@ -0,0 +1,74 @@
+#include "decode/lm_state_table.hh"
+
+#define BOOST_TEST_MODULE LMStateTableTest
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+
+namespace decode {
+namespace {
+
+// State of length words starting at first.  Entries past length are junk.
+lm::ngram::Right Make(unsigned char length, lm::WordIndex first, lm::WordIndex junk = 0) {
+  lm::ngram::Right ret;
+  for (unsigned char i = 0; i < KENLM_MAX_ORDER - 1; ++i) {
+    ret.words[i] = (i < length) ? first + i : junk;
+    ret.backoff[i] = -0.5;
+  }
+  ret.length = length;
+  return ret;
+}
+
+BOOST_AUTO_TEST_CASE(Equal) {
+  LMStateTable table;
+  LMStateTable::ID id = table.Intern(Make(2, 10));
+  BOOST_CHECK_EQUAL(id, table.Intern(Make(2, 10)));
+  // Only the first length words count.
+  BOOST_CHECK_EQUAL(id, table.Intern(Make(2, 10, 99)));
+  BOOST_CHECK_EQUAL(1U, table.Size());
+  BOOST_CHECK(Make(2, 10) == table[id]);
+
+  LMStateTable::ID empty = table.Intern(Make(0, 10));
+  BOOST_CHECK_EQUAL(empty, table.Intern(Make(0, 20, 7)));
+  BOOST_CHECK_EQUAL(2U, table.Size());
+}
+
+BOOST_AUTO_TEST_CASE(Different) {
+  LMStateTable table;
+  std::vector<LMStateTable::ID> ids;
+  ids.push_back(table.Intern(Make(2, 10)));
+  // Different words.
+  ids.push_back(table.Intern(Make(2, 11)));
+  // Prefix of the first.
+  ids.push_back(table.Intern(Make(1, 10)));
+  ids.push_back(table.Intern(Make(0, 10)));
+  BOOST_CHECK_EQUAL(ids.size(), table.Size());
+  for (std::size_t i = 0; i < ids.size(); ++i) {
+    for (std::size_t j = i + 1; j < ids.size(); ++j) {
+      BOOST_CHECK(ids[i] != ids[j]);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(Reallocate) {
+  LMStateTable table;
+  std::vector<LMStateTable::ID> ids;
+  ids.push_back(table.Intern(Make(2, 0)));
+  const std::size_t bytes = table.MemoryBytes();
+  // Enough states that the vector and the set grow several times.
+  const lm::WordIndex kStates = 1000;
+  for (lm::WordIndex i = 1; i < kStates; ++i) {
+    ids.push_back(table.Intern(Make(2, i)));
+  }
+  BOOST_CHECK(table.MemoryBytes() > bytes);
+  BOOST_CHECK_EQUAL(kStates, table.Size());
+  // Interning again finds the same ids, which still refer to their states.
+  for (lm::WordIndex i = 0; i < kStates; ++i) {
+    BOOST_CHECK_EQUAL(ids[i], table.Intern(Make(2, i, 5)));
+    BOOST_CHECK(Make(2, i) == table[ids[i]]);
+  }
+  BOOST_CHECK_EQUAL(kStates, table.Size());
+}
+
+} // namespace
+} // namespace decode
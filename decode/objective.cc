@@ -1,6 +1,12 @@
 #include "decode/objective.hh"
 
 #include "decode/weights.hh"
+#include "util/exception.hh"
+#include "util/string_stream.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
 
 namespace decode {
 
@@ -26,16 +32,53 @@ std::vector<float> Objective::GetFeatureValues(const Hypothesis &hypothesis) {
   return values;
 }
 
+namespace {
+
+// Weights folded into the table can't be changed, so the weights file must
+// agree with them.
+void CheckFolded(const Feature &feature, const Weights &loaded_weights) {
+  if (!loaded_weights.HasWeights(feature.name)) return;
+  std::vector<float> folded = feature.FoldedWeights();
+  if (folded.empty()) {
+    std::cerr << "Warning: the phrase table does not record the " << feature.name
+      << " weights folded into it, so the weights file can't be checked against them." << std::endl;
+    return;
+  }
+  std::vector<float> file = loaded_weights.GetWeights(feature.name);
+  bool same = (file.size() == folded.size());
+  for (std::size_t i = 0; same && i < file.size(); ++i) {
+    same = std::fabs(file[i] - folded[i]) <= 1e-6 * std::max(1.0f, std::fabs(folded[i]));
+  }
+  if (same) return;
+  util::StringStream folded_str, file_str;
+  for (float w : folded) folded_str << ' ' << w;
+  for (float w : file) file_str << ' ' << w;
+  UTIL_THROW2("The " << feature.name << " weights folded into the phrase table were"
+      << folded_str.str() << " but the weights file has" << file_str.str()
+      << ".  Rebuild the table or fix the weights file.");
+}
+
+} // namespace
+
 void Objective::LoadWeights(const Weights &loaded_weights) {
   assert(weights.size() == DenseFeatureCount());
   for (FeatureInfo feature : features_) {
+    if (feature.feature->WeightsFolded()) {
+      CheckFolded(*feature.feature, loaded_weights);
+      std::fill(weights.begin() + feature.offset,
+          weights.begin() + feature.offset + feature.feature->DenseFeatureCount(), 1.0);
+      continue;
+    }
     std::vector<float> feature_weights = loaded_weights.GetWeights(feature.feature->name);
     assert(feature_weights.size() == feature.feature->DenseFeatureCount());
     for (std::size_t j=0; j < feature_weights.size(); j++) {
       weights[feature.offset + j] = feature_weights[j];
     }
   }
-  if (store_feature_values_) {
+  // The fields are added to the layouts only once, so weights can be
+  // reloaded after phrases and hypotheses exist.
+  if (store_feature_values_ && !feature_value_fields_) {
+    feature_value_fields_ = true;
     phrase_feature_values_ = util::ArrayField<float>(
         feature_init_.target_phrase_layout, DenseFeatureCount());
     hypothesis_feature_values_ = util::ArrayField<float>(
@@ -8,7 +8,7 @@
 namespace decode {
 
 class Weights;
-class LM;
+template <class Model> class LM;
 class TargetPhraseInitializer;
 
 class Objective {
@@ -82,6 +82,7 @@ class Objective {
     std::size_t dense_feature_count_ = 0;
 
     bool store_feature_values_;
+    bool feature_value_fields_ = false;
     util::ArrayField<float> phrase_feature_values_;
     util::ArrayField<float> hypothesis_feature_values_;
 
@@ -3,12 +3,13 @@
 #include "decode/vocab_map.hh"
 #include "decode/feature_init.hh"
 #include "util/file_stream.hh"
+#include "util/string_stream.hh"
 
 #include <string.h>
 
 namespace decode {
 
-void PrintOptionalInfo(ScoreHistoryMap &map, float score_delta, util::FileStream &out) {
+template <class Stream> void PrintOptionalInfo(ScoreHistoryMap &map, float score_delta, Stream &out) {
   map["_total"].scores.push_back(score_delta);
   map["_total"].total += score_delta;
 
@@ -24,9 +25,9 @@ void PrintOptionalInfo(ScoreHistoryMap &map, float score_delta, util::FileStream
   }
 }
 
-void Output(const Hypothesis &hypo, const VocabMap &vocab,
-    ScoreHistoryMap &map, util::FileStream &out, const FeatureInit &feature_init,
-    bool verbose) {
+template <class Stream> void Output(const Hypothesis &hypo, const VocabMap &vocab,
+    ScoreHistoryMap &map, Stream &out, const FeatureInit &feature_init,
+    bool verbose, bool end_sentence) {
   std::vector<const Hypothesis*> hypos;
   for (const Hypothesis *h = &hypo; h; h = h->Previous()) {
     if (h->Target() == nullptr) continue;
@@ -35,7 +36,7 @@ void Output(const Hypothesis &hypo, const VocabMap &vocab,
   if (verbose) { out << hypo.GetScore(); }
   float previous_score = 0.0;
   assert(feature_init.phrase_access.target);
-  for (std::vector<const Hypothesis*>::const_reverse_iterator i = hypos.rbegin(); i != hypos.rend()-1/*ignore EOS*/; ++i) {
+  for (std::vector<const Hypothesis*>::const_reverse_iterator i = hypos.rbegin(); i != hypos.rend() - (end_sentence ? 1 : 0)/*ignore EOS*/; ++i) {
     auto ids = feature_init.phrase_access.target(feature_init.pt_row_field((*i)->Target()));
     for (const ID id : ids) {
       out << ' ' << vocab.String(id);
@@ -50,4 +51,11 @@ void Output(const Hypothesis &hypo, const VocabMap &vocab,
   }
 }
 
+template void Output(const Hypothesis &hypo, const VocabMap &vocab,
+    ScoreHistoryMap &map, util::FileStream &out, const FeatureInit &feature_init,
+    bool verbose, bool end_sentence);
+template void Output(const Hypothesis &hypo, const VocabMap &vocab,
+    ScoreHistoryMap &map, util::StringStream &out, const FeatureInit &feature_init,
+    bool verbose, bool end_sentence);
+
 } // namespace decode
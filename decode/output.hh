@@ -9,6 +9,7 @@
 
 namespace util {
 class FileStream;
+class StringStream;
 }
 
 namespace decode {
@@ -24,9 +25,11 @@ struct ScoreHistory {
 
 typedef boost::unordered_map<std::string, ScoreHistory> ScoreHistoryMap;
 
-void Output(const Hypothesis &hypo, const VocabMap &vocab,
-    ScoreHistoryMap &map, util::FileStream &out,
-    const FeatureInit &feature_init, bool verbose);
+// Stream is util::FileStream or util::StringStream.  hypo ends with </s>
+// unless it ends a segment in the middle of a sentence.
+template <class Stream> void Output(const Hypothesis &hypo, const VocabMap &vocab,
+    ScoreHistoryMap &map, Stream &out,
+    const FeatureInit &feature_init, bool verbose, bool end_sentence = true);
 
 } // namespace decode
 
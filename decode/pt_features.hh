@@ -50,6 +50,14 @@ class PhraseTableFeatures : public Feature {
       return phrase_access_->dense_features.size();
     }
 
+    bool WeightsFolded() const override {
+      return phrase_access_->weights_folded;
+    }
+
+    std::vector<float> FoldedWeights() const override {
+      return phrase_access_->folded_dense_weights;
+    }
+
     std::string FeatureDescription(std::size_t index) const override {
       assert(index < DenseFeatureCount());
       return "dense phrase table feature " + std::to_string(index);
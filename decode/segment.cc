@@ -0,0 +1,51 @@
+#include "decode/segment.hh"
+
+#include "util/spaces.hh"
+#include "util/tokenize_piece.hh"
+
+#include <algorithm>
+
+namespace decode {
+namespace {
+
+bool IsPunctuation(StringPiece word) {
+  for (const char *i = word.data(); i != word.data() + word.size(); ++i) {
+    switch (*i) {
+      case '.': case ',': case ';': case ':': case '!': case '?':
+        break;
+      default:
+        return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+void SplitSentence(StringPiece sentence, std::size_t max_words, std::vector<StringPiece> &segments) {
+  segments.clear();
+  std::vector<StringPiece> words;
+  for (util::TokenIter<util::BoolCharacter, true> word(sentence, util::kSpaces); word; ++word) {
+    words.push_back(*word);
+  }
+  if (!max_words || words.size() <= max_words) {
+    segments.push_back(sentence);
+    return;
+  }
+  for (std::size_t begin = 0; begin < words.size();) {
+    std::size_t end = std::min(words.size(), begin + max_words);
+    if (end < words.size()) {
+      for (std::size_t cut = end; cut > begin + 1; --cut) {
+        if (IsPunctuation(words[cut - 1])) {
+          end = cut;
+          break;
+        }
+      }
+    }
+    const char *first = words[begin].data();
+    segments.push_back(StringPiece(first, words[end - 1].data() + words[end - 1].size() - first));
+    begin = end;
+  }
+}
+
+} // namespace decode
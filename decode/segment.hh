@@ -0,0 +1,18 @@
+#pragma once
+
+#include "util/string_piece.hh"
+
+#include <cstddef>
+#include <vector>
+
+namespace decode {
+
+/* Splits a sentence longer than max_words into segments of at most max_words
+ * words so that search time grows linearly with length.  Each segment ends
+ * after the last punctuation token that fits or, if none does, after
+ * max_words.  Segments are decoded in turn with reordering confined to each
+ * one.  0 disables splitting, as does a sentence that fits.
+ */
+void SplitSentence(StringPiece sentence, std::size_t max_words, std::vector<StringPiece> &segments);
+
+} // namespace decode
@@ -0,0 +1,37 @@
+#include "decode/segment.hh"
+
+#define BOOST_TEST_MODULE SegmentTest
+#include <boost/test/unit_test.hpp>
+
+namespace decode {
+namespace {
+
+BOOST_AUTO_TEST_CASE(Short) {
+  std::vector<StringPiece> segments;
+  SplitSentence(" a b , c ", 4, segments);
+  BOOST_REQUIRE_EQUAL(1, segments.size());
+  BOOST_CHECK_EQUAL(" a b , c ", segments[0]);
+  SplitSentence("a b c d e", 0, segments);
+  BOOST_CHECK_EQUAL(1, segments.size());
+}
+
+BOOST_AUTO_TEST_CASE(AtPunctuation) {
+  std::vector<StringPiece> segments;
+  SplitSentence("a , b c ; d e  f g h i", 5, segments);
+  BOOST_REQUIRE_EQUAL(3, segments.size());
+  BOOST_CHECK_EQUAL("a , b c ;", segments[0]);
+  BOOST_CHECK_EQUAL("d e  f g h", segments[1]);
+  BOOST_CHECK_EQUAL("i", segments[2]);
+}
+
+BOOST_AUTO_TEST_CASE(WithoutPunctuation) {
+  std::vector<StringPiece> segments;
+  SplitSentence("a b c d e f g", 3, segments);
+  BOOST_REQUIRE_EQUAL(3, segments.size());
+  BOOST_CHECK_EQUAL("a b c", segments[0]);
+  BOOST_CHECK_EQUAL("d e f", segments[1]);
+  BOOST_CHECK_EQUAL("g", segments[2]);
+}
+
+} // namespace
+} // namespace decode
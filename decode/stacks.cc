@@ -3,7 +3,10 @@
 #include "decode/chart.hh"
 #include "decode/future.hh"
 #include "decode/hypothesis.hh"
+#include "lm/model.hh"
+#include "search/context.hh"
 #include "search/edge_generator.hh"
+#include "util/counter.hh"
 #include "util/murmur_hash.hh"
 #include "util/mutable_vocab.hh"
 
@@ -21,18 +24,18 @@ namespace {
 // that we are always appending to a hypothesis on the right side.
 void AddHypothesisToVertex(
     const Hypothesis *hypothesis, float score_delta, Hypothesis *next_hypothesis,
-    search::Vertex &vertex, FeatureInit &feature_init) {
+    search::Vertex &vertex, const FeatureInit &feature_init, const LMStateTable &lm_states) {
   search::HypoState add;
   add.history.cvp = next_hypothesis;
-  add.state.right = feature_init.lm_state_field(hypothesis);
+  add.state.right = lm_states[feature_init.lm_state_id_field(hypothesis)];
   add.state.left.length = 0;
   add.state.left.full = true;
   add.score = hypothesis->GetScore() + score_delta;
-  vertex.Root().AppendHypothesis(add);
+  vertex.AppendHypothesis(add);
 }
 
 void AddEdge(search::Vertex &hypos, search::Vertex &extensions, search::Note note, search::EdgeGenerator &out) {
-  hypos.Root().FinishRoot(search::kPolicyRight);
+  hypos.FinishRoot(search::kPolicyRight);
   if (hypos.Empty()) return;
   search::PartialEdge edge(out.AllocateEdge(2));
   // Empty LM state before/between/after
@@ -57,14 +60,24 @@ struct IntPairHash : public std::unary_function<const search::IntPair &, std::si
 
 class Vertices {
   public:
-    explicit Vertices(FeatureInit &feature_init) : feature_init_(feature_init) {}
+    Vertices(const FeatureInit &feature_init, const LMStateTable &lm_states)
+      : feature_init_(feature_init), lm_states_(lm_states) {}
 
     void Add(const Hypothesis *hypothesis, uint32_t source_begin, uint32_t source_end,
         Hypothesis *next_hypothesis, float score_delta) {
       search::IntPair key;
       key.first = source_begin;
       key.second = source_end;
-      AddHypothesisToVertex(hypothesis, score_delta, next_hypothesis, map_[key], feature_init_);
+      AddHypothesisToVertex(hypothesis, score_delta, next_hypothesis, Find(key), feature_init_, lm_states_);
+    }
+
+    // Append the hypotheses of other after those already here.  Merging
+    // contiguous pieces of the antecedents in order gives the same map as
+    // adding them all to one Vertices.
+    void Merge(const Vertices &other) {
+      for (std::vector<search::IntPair>::const_iterator i = other.order_.begin(); i != other.order_.end(); ++i) {
+        Find(*i).AppendHypotheses(other.map_.find(*i)->second);
+      }
     }
 
     void Apply(Chart &chart, search::EdgeGenerator &out) {
@@ -77,13 +90,75 @@ class Vertices {
     }
 
   private:
-    FeatureInit &feature_init_;
+    search::Vertex &Find(const search::IntPair &key) {
+      std::size_t before = map_.size();
+      search::Vertex &ret = map_[key];
+      if (map_.size() != before) order_.push_back(key);
+      return ret;
+    }
+
+    const FeatureInit &feature_init_;
+    const LMStateTable &lm_states_;
     // TODO: dense as 2D array?
     // Key is start and end
     typedef boost::unordered_map<search::IntPair, search::Vertex, IntPairHash> Map;
     Map map_;
+    // Keys in order of insertion.
+    std::vector<search::IntPair> order_;
+};
+
+struct ExpandInfo {
+  System &system;
+  const Chart &chart;
+  const Future &future;
+  const std::vector<Stack> &stacks;
+  // Only read while expanding.
+  LMStateTable &lm_states;
+  // Stacks [from_begin, source_words) continue into the stack for source_words.
+  std::size_t from_begin;
+  std::size_t source_words;
 };
 
+// Extend antecedents [ant_begin, ant_end), counted across the stacks being
+// continued from, with every source phrase they may cover next.
+void Expand(const ExpandInfo &info, std::size_t ant_begin, std::size_t ant_end,
+    HypothesisBuilder &builder, Vertices &vertices) {
+  const Chart &chart = info.chart;
+  std::size_t offset = 0;
+  // Iterate over stacks to continue from.
+  for (std::size_t from = info.from_begin; from < info.source_words && offset < ant_end; ++from) {
+    const Stack &stack = info.stacks[from];
+    const std::size_t phrase_length = info.source_words - from;
+    const std::size_t stack_begin = offset;
+    offset += stack.size();
+    // This stack ends before the block.
+    if (offset <= ant_begin) continue;
+    Stack::const_iterator ant = stack.begin() + (std::max(ant_begin, stack_begin) - stack_begin);
+    Stack::const_iterator ant_stop = stack.begin() + (std::min(ant_end, offset) - stack_begin);
+    // Iterate over antecedents in this stack.
+    for (; ant < ant_stop; ++ant) {
+      const Coverage &coverage = (*ant)->GetCoverage();
+      std::size_t begin = coverage.FirstZero();
+      const std::size_t last_end = std::min(coverage.FirstZero() + info.system.GetConfig().reordering_limit, chart.SentenceLength());
+      const std::size_t last_begin = (last_end > phrase_length) ? (last_end - phrase_length) : 0;
+      // We can always go from first_zero because it doesn't create a reordering gap.
+      do {
+        const TargetPhrases *phrases = chart.Range(begin, begin + phrase_length);
+        if (!phrases || !coverage.Compatible(begin, begin + phrase_length)) continue;
+        const Hypothesis *ant_hypo = *ant;
+        Hypothesis *next_hypo = builder.NextHypothesis(ant_hypo);
+        float score_delta = info.system.GetObjective().ScoreHypothesisWithSourcePhrase(
+            *ant_hypo, SourcePhrase(chart.Sentence(), begin, begin + phrase_length), next_hypo);
+        // Future costs: remove span to be filled.
+        score_delta += info.future.Change(coverage, ant_hypo->SourceEndIndex(), begin, begin + phrase_length);
+        next_hypo->SetScore(ant_hypo->GetScore() + score_delta);
+        vertices.Add(*ant, begin, begin + phrase_length, next_hypo, score_delta);
+      // Enforce the reordering limit on later iterations.
+      } while (++begin <= last_begin);
+    }
+  }
+}
+
 struct MergeInfo {
   Objective &objective;
   HypothesisBuilder &hypo_builder;
@@ -91,30 +166,33 @@ struct MergeInfo {
   float lm_weight;
 };
 
-template <class LMState>
 class Recombinator : public std::hash<const Hypothesis*>, public std::equal_to<const Hypothesis*> {
   public:
+    // In monotone search, hypotheses in a stack have the same coverage.
     Recombinator(
-        const util::PODField<LMState> lm_state_field,
-        const Objective &objective)
-      : lm_state_field_(lm_state_field), objective_(objective) {}
+        const util::PODField<LMStateTable::ID> lm_state_id_field,
+        const Objective &objective,
+        bool monotone)
+      : lm_state_id_field_(lm_state_id_field), objective_(objective), monotone_(monotone) {}
 
     size_t operator()(const Hypothesis *hypothesis) const {
       std::size_t source_index = hypothesis->SourceEndIndex();
       return util::MurmurHashNative(&source_index, sizeof(std::size_t),
-          hash_value(lm_state_field_(hypothesis), hash_value(hypothesis->GetCoverage())));
+          util::MurmurHashNative(&lm_state_id_field_(hypothesis), sizeof(LMStateTable::ID), monotone_ ? 0 : hash_value(hypothesis->GetCoverage())));
     }
 
     bool operator()(const Hypothesis *first, const Hypothesis *second) const {
-      if (! (lm_state_field_(first) == lm_state_field_(second))) return false;
-      if (! (first->GetCoverage() == second->GetCoverage())) return false;
+      // States are interned so equal states have equal ids.
+      if (lm_state_id_field_(first) != lm_state_id_field_(second)) return false;
+      if (!monotone_ && !(first->GetCoverage() == second->GetCoverage())) return false;
       if (! (first->SourceEndIndex() == second->SourceEndIndex())) return false;
       return objective_.HypothesisEqual(*first, *second);
     }
 
   private:
-    const util::PODField<LMState> lm_state_field_;
+    const util::PODField<LMStateTable::ID> lm_state_id_field_;
     const Objective &objective_;
+    const bool monotone_;
 };
 
 Hypothesis *GetHypothesis(search::PartialEdge complete) {
@@ -161,7 +239,7 @@ void UpdateHypothesisInEdge(search::PartialEdge complete, MergeInfo &merge_info)
 // TODO n-best lists.
 class EdgeOutput {
   public:
-    typedef boost::unordered_set<Hypothesis *, Recombinator<LMState>, Recombinator<LMState>> Dedupe;
+    typedef boost::unordered_set<Hypothesis *, Recombinator, Recombinator> Dedupe;
 
     EdgeOutput(Stack &stack, MergeInfo merge_info, Dedupe deduper, search::EdgeGenerator &gen)
       : stack_(stack), merge_info_(merge_info), deduper_(deduper), queue_(gen) {}
@@ -172,10 +250,12 @@ class EdgeOutput {
         queue_.AddEdge(complete);
         return false;
       }
+      UTIL_COUNT("decode/hypotheses");
       stack_.push_back(GetHypothesis(complete));
       // Note: stack_ has reserved for pop limit so pointers should survive.
       std::pair<Dedupe::iterator, bool> res(deduper_.insert(stack_.back()));
       if (!res.second) {
+        UTIL_COUNT("decode/recombinations");
         // Already present.  Keep the top-scoring one.
         Hypothesis *already = *res.first;
         if (already->GetScore() < stack_.back()->GetScore()) {
@@ -240,10 +320,19 @@ class PickBest {
 
 } // namespace
 
-Stacks::Stacks(System &system, Chart &chart) :
-  hypothesis_builder_(hypothesis_pool_, system.GetObjective().GetFeatureInit()) {
+template <class Model> Stacks::Stacks(System &system, Chart &chart, const Model &model,
+    const lm::ngram::Right *begin_state, bool end_sentence) :
+  hypothesis_builder_(hypothesis_pool_, system.GetObjective().GetFeatureInit(), lm_states_) {
   FeatureInit &feature_init = system.GetObjective().GetFeatureInit();
-  Future future(chart);
+  search::Context<Model> context(system.SearchContext().GetConfig(), model);
+  system.GetJoinMemo().NewSentence();
+  const std::size_t expand_threads = std::max<std::size_t>(1, system.GetConfig().expand_threads);
+  for (std::size_t worker = 1; worker < expand_threads; ++worker) {
+    worker_pools_.push_back(new util::Pool());
+  }
+  Future future(chart, system.GetConfig().future_distortion ? system.GetWeights().DistortionWeight() : 0.0);
+  // Without reordering, coverage is implied by the stack.
+  const bool monotone = system.GetConfig().reordering_limit == 0;
   // Reservation is critical because pointers to Hypothesis objects are retained as history.
   stacks_.reserve(chart.SentenceLength() + 2 /* begin/end of sentence */);
   stacks_.resize(1);
@@ -252,52 +341,70 @@ Stacks::Stacks(System &system, Chart &chart) :
   pt::Row *target = access.Allocate(hypothesis_pool_);
   system.GetObjective().InitPassthroughPhrase(target, TargetPhraseType::Begin);
   stacks_[0].push_back(hypothesis_builder_.BuildHypothesis(
-        system.GetObjective().BeginSentenceState(),
+        begin_state ? *begin_state : system.GetObjective().BeginSentenceState(),
         future.Full(), target));
   // Decode with increasing numbers of source words.
   for (std::size_t source_words = 1; source_words <= chart.SentenceLength(); ++source_words) {
-    Vertices vertices(feature_init);
-    // Iterate over stacks to continue from.
-    for (std::size_t from = source_words - std::min(source_words, chart.MaxSourcePhraseLength());
-         from < source_words;
-         ++from) {
-      const std::size_t phrase_length = source_words - from;
-      // Iterate over antecedents in this stack.
-      for (Stack::const_iterator ant = stacks_[from].begin(); ant != stacks_[from].end(); ++ant) {
-        const Coverage &coverage = (*ant)->GetCoverage();
-        std::size_t begin = coverage.FirstZero();
-        const std::size_t last_end = std::min(coverage.FirstZero() + system.GetConfig().reordering_limit, chart.SentenceLength());
-        const std::size_t last_begin = (last_end > phrase_length) ? (last_end - phrase_length) : 0;
-        // We can always go from first_zero because it doesn't create a reordering gap.
-        do {
-          const TargetPhrases *phrases = chart.Range(begin, begin + phrase_length);
-          if (!phrases || !coverage.Compatible(begin, begin + phrase_length)) continue;
-          const Hypothesis *ant_hypo = *ant;
-          Hypothesis *next_hypo = hypothesis_builder_.NextHypothesis(ant_hypo);
-          float score_delta = system.GetObjective().ScoreHypothesisWithSourcePhrase(
-              *ant_hypo, SourcePhrase(chart.Sentence(), begin, begin + phrase_length), next_hypo);
-          // Future costs: remove span to be filled.
-          score_delta += future.Change(coverage, begin, begin + phrase_length);
-          next_hypo->SetScore(ant_hypo->GetScore() + score_delta);
-          vertices.Add(*ant, begin, begin + phrase_length, next_hypo, score_delta);
-        // Enforce the reordering limit on later iterations.
-        } while (++begin <= last_begin);
+    Vertices vertices(feature_init, lm_states_);
+    const std::size_t from_begin = source_words - std::min(source_words, chart.MaxSourcePhraseLength());
+    ExpandInfo info{system, chart, future, stacks_, lm_states_, from_begin, source_words};
+    std::size_t antecedents = 0;
+    for (std::size_t from = from_begin; from < source_words; ++from) {
+      antecedents += stacks_[from].size();
+    }
+    const std::size_t threads = std::max<std::size_t>(1, std::min(expand_threads, antecedents));
+    if (threads == 1) {
+      Expand(info, 0, antecedents, hypothesis_builder_, vertices);
+    } else {
+      // Each thread extends a contiguous block of antecedents into its own
+      // Vertices; merging the blocks in order matches the serial result.
+      boost::ptr_vector<Vertices> worker_vertices;
+      for (std::size_t worker = 1; worker < threads; ++worker) {
+        worker_vertices.push_back(new Vertices(feature_init, lm_states_));
+      }
+      system.GetWorkers().Run(threads, [&](std::size_t worker) {
+        const std::size_t ant_begin = antecedents * worker / threads, ant_end = antecedents * (worker + 1) / threads;
+        if (worker) {
+          HypothesisBuilder builder(worker_pools_[worker - 1], feature_init, lm_states_);
+          Expand(info, ant_begin, ant_end, builder, worker_vertices[worker - 1]);
+        } else {
+          Expand(info, ant_begin, ant_end, hypothesis_builder_, vertices);
+        }
+      });
+      for (std::size_t worker = 1; worker < threads; ++worker) {
+        vertices.Merge(worker_vertices[worker - 1]);
       }
     }
-    search::EdgeGenerator gen;
+    search::EdgeGenerator gen(&system.GetJoinMemo());
     vertices.Apply(chart, gen);
     stacks_.resize(stacks_.size() + 1);
     stacks_.back().reserve(system.SearchContext().PopLimit());
-    Recombinator<LMState> recombinator(feature_init.lm_state_field, system.GetObjective());
+    Recombinator recombinator(feature_init.lm_state_id_field, system.GetObjective(), monotone);
     EdgeOutput::Dedupe deduper(system.SearchContext().PopLimit(), recombinator, recombinator);
     MergeInfo merge_info{system.GetObjective(), hypothesis_builder_, chart, system.SearchContext().LMWeight()};
     EdgeOutput output(stacks_.back(), merge_info, deduper, gen);
-    gen.Search(system.SearchContext(), output);
+    gen.Search(context, output);
+    edge_memory_.Add("search/partial_edges", gen.EdgePool());
+  }
+  if (end_sentence) {
+    PopulateLastStack(system, chart, context);
+  } else {
+    PickLastStack(chart.SentenceLength());
   }
-  PopulateLastStack(system, chart);
 }
 
-void Stacks::PopulateLastStack(System &system, Chart &chart) {
+void Stacks::PickLastStack(std::size_t source_words) {
+  const Stack &complete = stacks_[source_words];
+  Hypothesis *best = NULL;
+  for (Stack::const_iterator i = complete.begin(); i != complete.end(); ++i) {
+    if (!best || (*i)->GetScore() > best->GetScore()) best = *i;
+  }
+  stacks_.resize(stacks_.size() + 1);
+  if (best) stacks_.back().push_back(best);
+  end_ = best;
+}
+
+template <class Model> void Stacks::PopulateLastStack(System &system, Chart &chart, const search::Context<Model> &context) {
   // First, make Vertex of all hypotheses
   search::Vertex all_hyps;
   for (Stack::const_iterator ant = stacks_[chart.SentenceLength()].begin(); ant != stacks_[chart.SentenceLength()].end(); ++ant) {
@@ -308,14 +415,14 @@ void Stacks::PopulateLastStack(System &system, Chart &chart) {
     float score_delta = system.GetObjective().ScoreHypothesisWithSourcePhrase(
         *ant_hypo, source_phrase, next_hypo);
     next_hypo->SetScore(ant_hypo->GetScore() + score_delta);
-    AddHypothesisToVertex(ant_hypo, score_delta, next_hypo, all_hyps, system.GetObjective().GetFeatureInit());
+    AddHypothesisToVertex(ant_hypo, score_delta, next_hypo, all_hyps, system.GetObjective().GetFeatureInit(), lm_states_);
   }
   
   // Next, make Vertex which consists of a single EOS phrase.
   // The seach algorithm will attempt to find the best hypotheses in the "cross product" of these two sets.
   search::Vertex &eos_vertex = chart.EndOfSentence();
   // Add edge that tacks </s> on
-  search::EdgeGenerator gen;
+  search::EdgeGenerator gen(&system.GetJoinMemo());
   search::Note note;
   note.ints.first = chart.SentenceLength();
   note.ints.second = chart.SentenceLength();
@@ -324,9 +431,47 @@ void Stacks::PopulateLastStack(System &system, Chart &chart) {
   stacks_.resize(stacks_.size() + 1);
   MergeInfo merge_info{system.GetObjective(), hypothesis_builder_, chart,system.SearchContext().LMWeight()};
   PickBest output(stacks_.back(), merge_info, gen);
-  gen.Search(system.SearchContext(), output);
+  // This search runs until the queue is empty: there is one </s> phrase, so
+  // it completes at most one hypothesis per antecedent, which is within the
+  // pop limit.  It can't stop once the best completion beats the queue
+  // either, because the queue is not an upper bound: revealing more of an
+  // antecedent's context to </s> often raises the language model score.
+  gen.Search(context, output);
+  edge_memory_.Add("search/partial_edges", gen.EdgePool());
 
   end_ = stacks_.back().empty() ? NULL : stacks_.back()[0];
 }
 
+void Stacks::CompleteRows(const FeatureInit &feature_init, RowSet &rows) const {
+  // The last two stacks are the whole sentence and its chosen ending.
+  if (stacks_.size() < 2) return;
+  const Stack &complete = stacks_[stacks_.size() - 2];
+  for (Stack::const_iterator i = complete.begin(); i != complete.end(); ++i) {
+    for (const Hypothesis *hypo = *i; hypo->Previous(); hypo = hypo->Previous()) {
+      rows.insert(feature_init.pt_row_field(hypo->Target()));
+    }
+  }
+}
+
+void Stacks::ReportMemory(util::PoolReport &report) const {
+  report.Add("stacks/hypotheses", hypothesis_pool_);
+  for (boost::ptr_vector<util::Pool>::const_iterator i = worker_pools_.begin(); i != worker_pools_.end(); ++i) {
+    report.Add("stacks/hypotheses", *i);
+  }
+  std::size_t pointers = 0;
+  for (std::vector<Stack>::const_iterator i = stacks_.begin(); i != stacks_.end(); ++i) {
+    pointers += i->capacity() * sizeof(Hypothesis*);
+  }
+  report.AddBytes("stacks/pointers", pointers);
+  report.AddBytes("stacks/lm_states", lm_states_.MemoryBytes());
+  report.Add(edge_memory_);
+}
+
+template Stacks::Stacks(System &system, Chart &chart, const lm::ngram::ProbingModel &model, const lm::ngram::Right *begin_state, bool end_sentence);
+template Stacks::Stacks(System &system, Chart &chart, const lm::ngram::RestProbingModel &model, const lm::ngram::Right *begin_state, bool end_sentence);
+template Stacks::Stacks(System &system, Chart &chart, const lm::ngram::TrieModel &model, const lm::ngram::Right *begin_state, bool end_sentence);
+template Stacks::Stacks(System &system, Chart &chart, const lm::ngram::QuantTrieModel &model, const lm::ngram::Right *begin_state, bool end_sentence);
+template Stacks::Stacks(System &system, Chart &chart, const lm::ngram::ArrayTrieModel &model, const lm::ngram::Right *begin_state, bool end_sentence);
+template Stacks::Stacks(System &system, Chart &chart, const lm::ngram::QuantArrayTrieModel &model, const lm::ngram::Right *begin_state, bool end_sentence);
+
 } // namespace decode
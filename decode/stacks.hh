@@ -2,10 +2,18 @@
 
 #include "decode/system.hh"
 #include "decode/hypothesis_builder.hh"
+#include "decode/lm_state_table.hh"
+#include "decode/types.hh"
+#include "util/pool.hh"
+
+#include <boost/ptr_container/ptr_vector.hpp>
 
 #include <vector>
 
-namespace search { class EdgeGenerator; }
+namespace search {
+class EdgeGenerator;
+template <class Model> class Context;
+} // namespace search
 
 namespace decode {
 
@@ -15,20 +23,49 @@ typedef std::vector<Hypothesis*> Stack;
 
 class Stacks {
   public:
-    Stacks(System &system, Chart &chart);
+    // Model is the type of the language model, one of those instantiated in
+    // stacks.cc.  A segment of a longer sentence may begin in the language
+    // model state where the previous one ended instead of <s>, and ends
+    // without </s> unless it is the last.
+    template <class Model> Stacks(System &system, Chart &chart, const Model &model,
+        const lm::ngram::Right *begin_state = NULL, bool end_sentence = true);
 
     // NULL if no hypothesis.
     const Hypothesis *End() const { return end_; }
 
+    // Language model state after End(), which must not be NULL.
+    const lm::ngram::Right &EndState(const FeatureInit &feature_init) const {
+      return lm_states_[feature_init.lm_state_id_field(end_)];
+    }
+
+    // Add the table rows on the paths of the hypotheses that cover the whole
+    // sentence, before </s>, to rows.
+    void CompleteRows(const FeatureInit &feature_init, RowSet &rows) const;
+
+    // Adds stacks/* and search/* entries.
+    void ReportMemory(util::PoolReport &report) const;
+
   private:
-    void PopulateLastStack(System &system, Chart &chart);
+    template <class Model> void PopulateLastStack(System &system, Chart &chart, const search::Context<Model> &context);
+
+    // Without </s>, the last stack is just the best complete hypothesis.
+    void PickLastStack(std::size_t source_words);
+
     std::vector<Stack> stacks_;
 
     util::Pool hypothesis_pool_;
 
+    LMStateTable lm_states_;
+
+    // Hypotheses made by expansion threads other than the caller.
+    boost::ptr_vector<util::Pool> worker_pools_;
+
     HypothesisBuilder hypothesis_builder_;
 
     const Hypothesis *end_;
+
+    // Pools of search::EdgeGenerator, which only live while filling a stack.
+    util::PoolReport edge_memory_;
 };
 
 } // namespace decode
@@ -0,0 +1,216 @@
+#include "decode/stacks.hh"
+
+#include "decode/chart.hh"
+#include "decode/distortion.hh"
+#include "decode/lexro.hh"
+#include "decode/lm.hh"
+#include "decode/passthrough.hh"
+#include "decode/phrase_count_feature.hh"
+#include "decode/pt_features.hh"
+#include "decode/word_insert.hh"
+#include "pt/create.hh"
+#include "pt/query.hh"
+#include "pt/statistics.hh"
+#include "util/file.hh"
+
+#define BOOST_TEST_MODULE StacksTest
+#include <boost/test/unit_test.hpp>
+
+#include <boost/scoped_ptr.hpp>
+
+#include <algorithm>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace decode {
+namespace {
+
+typedef lm::ngram::ProbingModel Model;
+
+const char *Argument(int index, const char *otherwise) {
+  if (boost::unit_test::framework::master_test_suite().argc <= index) {
+    return otherwise;
+  }
+  return boost::unit_test::framework::master_test_suite().argv[index];
+}
+
+// Binary table with one-word phrases for every word of kSentence and several
+// longer phrases, some of which a small beam leaves off complete paths.
+int MakeTable() {
+  util::scoped_fd text(util::MakeTemp(util::DefaultTempDirectory()));
+  const char rows[] =
+    "a ||| the ||| 0.5 0.5 0.5 0.5 2.718 ||| 1 1 1 1 1 1\n"
+    "a ||| a ||| 0.3 0.3 0.3 0.3 2.718 ||| 1 1 1 1 1 1\n"
+    "a b ||| the small ||| 0.4 0.4 0.4 0.4 2.718 ||| 1 1 1 1 1 1\n"
+    "a b ||| a little ||| 0.2 0.2 0.2 0.2 2.718 ||| 1 1 1 1 1 1\n"
+    "a b ||| foo bar ||| 0.01 0.01 0.01 0.01 2.718 ||| 1 1 1 1 1 1\n"
+    "a b c ||| foo bar baz ||| 0.01 0.01 0.01 0.01 2.718 ||| 1 1 1 1 1 1\n"
+    "b ||| small ||| 0.6 0.6 0.6 0.6 2.718 ||| 1 1 1 1 1 1\n"
+    "b ||| little ||| 0.4 0.4 0.4 0.4 2.718 ||| 1 1 1 1 1 1\n"
+    "b c ||| little screening ||| 0.3 0.3 0.3 0.3 2.718 ||| 1 1 1 1 1 1\n"
+    "c ||| screening ||| 0.9 0.9 0.9 0.9 2.718 ||| 1 1 1 1 1 1\n"
+    "c d ||| screening is ||| 0.5 0.5 0.5 0.5 2.718 ||| 1 1 1 1 1 1\n"
+    "c d ||| baz foo ||| 0.01 0.01 0.01 0.01 2.718 ||| 1 1 1 1 1 1\n"
+    "d ||| is ||| 0.8 0.8 0.8 0.8 2.718 ||| 1 1 1 1 1 1\n";
+  util::WriteOrThrow(text.get(), rows, sizeof(rows) - 1 /* no null at end */);
+  util::SeekOrThrow(text.get(), 0);
+  util::scoped_fd binary(util::MakeTemp(util::DefaultTempDirectory()));
+  std::vector<std::string> names = {"source", "target", "dense_features", "lexical_reordering"};
+  pt::TextColumns columns;
+  pt::FieldConfig fields;
+  pt::BindColumns(names, columns, fields);
+  pt::CreateTable(text.release(), util::DupOrThrow(binary.get()), columns, fields);
+  util::SeekOrThrow(binary.get(), 0);
+  return binary.release();
+}
+
+Weights ReadWeights() {
+  Weights weights;
+  weights.ReadFromFile(Argument(2, "test.weights"));
+  return weights;
+}
+
+Config SmallBeam() {
+  Config config;
+  config.reordering_limit = 2;
+  config.pop_limit = 3;
+  return config;
+}
+
+const char kSentence[] = "a b c d";
+
+// The features decode adds, on a small beam.
+struct SystemFixture {
+  SystemFixture()
+    : table(MakeTable(), util::READ),
+      weights(ReadWeights()),
+      lm(Argument(1, "test.arpa")),
+      system(SmallBeam(), table.Accessor(), weights, lm.GetModel().BeginSentenceState()),
+      cache(NoCache()) {
+    Objective &objective = system.GetObjective();
+    objective.AddFeature(distortion);
+    objective.AddFeature(passthrough);
+    objective.AddFeature(word_insert);
+    objective.AddFeature(phrase_count_feature);
+    objective.AddFeature(pt_features);
+    objective.AddFeature(lm);
+    objective.RegisterLanguageModel(lm);
+    objective.AddFeature(lexro);
+    system.LoadVocab(table.Vocab(), table.Stats().vocab_size);
+    system.LoadWeights();
+  }
+
+  static VertexCache::Config NoCache() {
+    VertexCache::Config config;
+    config.max_bytes = 0;
+    return config;
+  }
+
+  Chart *Load(boost::scoped_ptr<Chart> &chart, const RowSet *keep) {
+    chart.reset(new Chart(table.Stats().max_source_phrase_length, system.GetBaseVocab(), system.GetObjective(), cache));
+    chart->ReadSentence(kSentence);
+    chart->LoadPhrases(table, system.GetWorkers(), 1, keep);
+    return chart.get();
+  }
+
+  // Rows of the span's target phrases, leaving the vertex ready for search.
+  std::set<const pt::Row*> SpanRows(Chart &chart, std::size_t begin, std::size_t end) {
+    std::set<const pt::Row*> ret;
+    TargetPhrases *vertex = chart.Range(begin, end);
+    if (!vertex) return ret;
+    const std::vector<search::HypoState> &hypos = vertex->ReopenRoot();
+    for (std::vector<search::HypoState>::const_iterator i = hypos.begin(); i != hypos.end(); ++i) {
+      ret.insert(system.GetObjective().GetFeatureInit().pt_row_field(reinterpret_cast<const TargetPhrase*>(i->history.cvp)));
+    }
+    vertex->FinishRoot(search::kPolicyLeft);
+    return ret;
+  }
+
+  pt::Table table;
+  Weights weights;
+  LM<Model> lm;
+  Distortion distortion;
+  Passthrough passthrough;
+  WordInsertion word_insert;
+  PhraseCountFeature phrase_count_feature;
+  PhraseTableFeatures pt_features;
+  LexicalizedReordering lexro;
+  System system;
+  VertexCache cache;
+};
+
+BOOST_FIXTURE_TEST_SUITE(suite, SystemFixture)
+
+BOOST_AUTO_TEST_CASE(KeepCompleteRows) {
+  boost::scoped_ptr<Chart> full_chart, pruned_chart;
+  Chart &full = *Load(full_chart, NULL);
+  RowSet rows;
+  {
+    Stacks stacks(system, full, lm.GetModel());
+    BOOST_REQUIRE(stacks.End());
+    stacks.CompleteRows(system.GetObjective().GetFeatureInit(), rows);
+    // The best translation is among the complete hypotheses.  End() is </s>.
+    for (const Hypothesis *hypo = stacks.End()->Previous(); hypo->Previous(); hypo = hypo->Previous()) {
+      BOOST_CHECK(rows.count(system.GetObjective().GetFeatureInit().pt_row_field(hypo->Target())));
+    }
+  }
+  BOOST_CHECK(!rows.empty());
+
+  Chart &pruned = *Load(pruned_chart, &rows);
+  std::size_t dropped = 0;
+  for (std::size_t begin = 0; begin < full.SentenceLength(); ++begin) {
+    // Every word keeps all of its one-word phrases.
+    std::set<const pt::Row*> expected = SpanRows(full, begin, begin + 1);
+    std::set<const pt::Row*> actual = SpanRows(pruned, begin, begin + 1);
+    BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(), actual.begin(), actual.end());
+    for (std::size_t end = begin + 2; end <= std::min(full.SentenceLength(), begin + full.MaxSourcePhraseLength()); ++end) {
+      // Longer phrases are only those on complete hypotheses.
+      std::set<const pt::Row*> all = SpanRows(full, begin, end);
+      expected.clear();
+      for (std::set<const pt::Row*>::const_iterator i = all.begin(); i != all.end(); ++i) {
+        if (rows.count(*i)) expected.insert(*i);
+      }
+      dropped += all.size() - expected.size();
+      actual = SpanRows(pruned, begin, end);
+      BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(), actual.begin(), actual.end());
+      BOOST_CHECK_EQUAL(expected.empty(), !pruned.Range(begin, end));
+    }
+  }
+  // The beam is small enough that pruning did something.
+  BOOST_CHECK(dropped);
+  Stacks stacks(system, pruned, lm.GetModel());
+  BOOST_CHECK(stacks.End());
+}
+
+BOOST_AUTO_TEST_CASE(FallBack) {
+  boost::scoped_ptr<Chart> full_chart, all_chart, none_chart;
+  Chart &full = *Load(full_chart, NULL);
+  // Without rows to keep, as when the coarse pass finds no translation,
+  // every phrase is loaded.
+  Chart &all = *Load(all_chart, NULL);
+  // Keeping no rows still leaves the one-word phrases to translate with.
+  RowSet nothing;
+  Chart &none = *Load(none_chart, &nothing);
+  for (std::size_t begin = 0; begin < full.SentenceLength(); ++begin) {
+    for (std::size_t end = begin + 1; end <= std::min(full.SentenceLength(), begin + full.MaxSourcePhraseLength()); ++end) {
+      std::set<const pt::Row*> expected = SpanRows(full, begin, end);
+      std::set<const pt::Row*> actual = SpanRows(all, begin, end);
+      BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(), actual.begin(), actual.end());
+      if (end == begin + 1) {
+        BOOST_CHECK(!expected.empty());
+        actual = SpanRows(none, begin, end);
+        BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(), actual.begin(), actual.end());
+      } else {
+        BOOST_CHECK(!none.Range(begin, end));
+      }
+    }
+  }
+  Stacks stacks(system, none, lm.GetModel());
+  BOOST_CHECK(stacks.End());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace
+} // namespace decode
@@ -3,19 +3,29 @@
 #include "pt/access.hh"
 #include "pt/format.hh"
 
+#include <algorithm>
+
 namespace decode {
   
 System::System(const Config config, const pt::Access &phrase_access,
-    const Weights &weights, const lm::ngram::Model &lm)
-  : config_(config), weights_(weights),
-  objective_(phrase_access, lm.BeginSentenceState()),
+    const Weights &weights, const lm::ngram::State &lm_begin_sentence_state)
+  : config_(config), weights_(&weights),
+  objective_(phrase_access, lm_begin_sentence_state),
   search_context_(search::Config(
         weights.LMWeight(),
         config.pop_limit,
-        search::NBestConfig(1)), lm) {}
+        search::NBestConfig(1))),
+  join_memo_(config.join_memo_slots),
+  workers_(std::max(config.phrase_threads, config.expand_threads)) {}
 
 void System::LoadWeights() {
-  objective_.LoadWeights(weights_);
+  objective_.LoadWeights(*weights_);
+}
+
+void System::LoadWeights(const Weights &weights) {
+  weights_ = &weights;
+  objective_.LoadWeights(weights);
+  search_context_.SetLMWeight(weights.LMWeight());
 }
 
 void System::LoadVocab(pt::VocabRange vocab_range, std::size_t vocab_size) {
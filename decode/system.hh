@@ -1,9 +1,11 @@
 #pragma once
 
-#include "lm/model.hh"
+#include "lm/state.hh"
 #include "decode/objective.hh"
 #include "decode/weights.hh"
+#include "decode/workers.hh"
 #include "search/context.hh"
+#include "search/join_memo.hh"
 
 namespace pt {
   struct VocabRange;
@@ -15,6 +17,21 @@ namespace decode {
 struct Config {
   std::size_t reordering_limit;
   unsigned int pop_limit;
+  // Include the distortion still owed for gaps in future cost estimates.
+  bool future_distortion = false;
+  // Threads used to look up and score the phrases of a sentence.
+  std::size_t phrase_threads = 1;
+  // Threads used to extend antecedent hypotheses into each stack.
+  std::size_t expand_threads = 1;
+  // Slots remembering language model joins in search.  0 disables.  Pays off
+  // when the language model is too large for the cache.
+  std::size_t join_memo_slots = 0;
+  // Words of target phrases scored together after prefetching their
+  // language model entries.  1 disables.  Only probing models prefetch.
+  std::size_t lm_prefetch_group = 1;
+  // Sentences longer than this are searched in segments that reordering
+  // does not cross; see SplitSentence.  0 disables.
+  std::size_t max_segment_words = 0;
 };
 
 struct BaseVocab {
@@ -31,15 +48,21 @@ struct BaseVocab {
 class System {
   public:
     System(const Config config, const pt::Access &phrase_access,
-        const Weights &weights, const lm::ngram::Model &lm);
+        const Weights &weights, const lm::ngram::State &lm_begin_sentence_state);
 
     void LoadWeights();
 
+    // Switch to other weights.  Charts loaded earlier must be rescored.
+    void LoadWeights(const Weights &weights);
+
     void LoadVocab(pt::VocabRange vocab, std::size_t vocab_size);
 
     const Config &GetConfig() const { return config_; }
 
-    const search::Context<lm::ngram::Model> &SearchContext() const {
+    const Weights &GetWeights() const { return *weights_; }
+
+    // Stacks pairs this with the language model as a search::Context.
+    const search::ContextBase &SearchContext() const {
       return search_context_;
     }
 
@@ -47,6 +70,12 @@ class System {
 
     BaseVocab &GetBaseVocab() { return base_vocab_; }
 
+    // Joins depend only on the language model, so this outlives sentences.
+    search::JoinMemo &GetJoinMemo() { return join_memo_; }
+
+    // Enough threads for phrase_threads and expand_threads.
+    Workers &GetWorkers() { return workers_; }
+
   private:
     void InsertNewWord(const ID id);
 
@@ -55,8 +84,12 @@ class System {
 
     BaseVocab base_vocab_;
 
-    search::Context<lm::ngram::Model> search_context_;
-    const Weights &weights_;
+    search::ContextBase search_context_;
+    const Weights *weights_;
+
+    search::JoinMemo join_memo_;
+
+    Workers workers_;
 };
   
 } // namespace decode
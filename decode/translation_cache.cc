@@ -0,0 +1,184 @@
+#include "decode/translation_cache.hh"
+
+#include "util/exception.hh"
+#include "util/file.hh"
+#include "util/file_stream.hh"
+#include "util/mmap.hh"
+#include "util/murmur_hash.hh"
+#include "util/tokenize_piece.hh"
+
+#include <cstring>
+#include <iostream>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace decode {
+
+namespace {
+const char kMagicPrefix[] = "mtplz translation cache v";
+const char kMagic[] = "mtplz translation cache v2\n";
+
+// Record in a saved file, followed by input_length bytes of normalized input
+// and length bytes of output.
+struct Record {
+  uint64_t key;
+  float score;
+  uint32_t input_length;
+  uint32_t length;
+};
+} // namespace
+
+TranslationCache::TranslationCache(std::size_t max_bytes, uint64_t fingerprint)
+  : max_bytes_(max_bytes), fingerprint_(fingerprint), bytes_(0), hits_(0), misses_(0) {}
+
+TranslationCache::Key TranslationCache::MakeKey(StringPiece input) const {
+  Key key;
+  // Same tokenization as Chart::ReadSentence.
+  for (util::TokenIter<util::BoolCharacter, true> word(input, util::kSpaces); word; ++word) {
+    if (!key.input.empty()) key.input += ' ';
+    key.input.append(word->data(), word->size());
+  }
+  key.hash = util::MurmurHashNative(key.input.data(), key.input.size(), fingerprint_);
+  return key;
+}
+
+bool TranslationCache::Find(const Key &key, std::string &output, float &score) {
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  Map::iterator found = map_.find(key.hash);
+  if (found == map_.end() || found->second.input != key.input) {
+    ++misses_;
+    return false;
+  }
+  ++hits_;
+  recency_.splice(recency_.begin(), recency_, found->second.recent);
+  output = found->second.output;
+  score = found->second.score;
+  return true;
+}
+
+void TranslationCache::Insert(const Key &key, StringPiece output, float score) {
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  InsertLocked(key.hash, key.input, output, score);
+}
+
+void TranslationCache::InsertLocked(uint64_t hash, StringPiece input, StringPiece output, float score) {
+  std::pair<Map::iterator, bool> ins(map_.insert(Map::value_type(hash, Value())));
+  Value &value = ins.first->second;
+  if (ins.second) {
+    recency_.push_front(hash);
+  } else {
+    bytes_ -= Bytes(value);
+    recency_.splice(recency_.begin(), recency_, value.recent);
+  }
+  value.input.assign(input.data(), input.size());
+  value.output.assign(output.data(), output.size());
+  value.score = score;
+  value.recent = recency_.begin();
+  bytes_ += Bytes(value);
+  while (bytes_ > max_bytes_ && !recency_.empty()) {
+    Map::iterator evict = map_.find(recency_.back());
+    bytes_ -= Bytes(evict->second);
+    map_.erase(evict);
+    recency_.pop_back();
+  }
+}
+
+std::size_t TranslationCache::Bytes(const Value &value) {
+  // Map node and bucket, list node, and the strings' buffers.
+  return sizeof(Map::value_type) + 2 * sizeof(void*)
+    + sizeof(uint64_t) + 2 * sizeof(void*)
+    + value.input.capacity() + value.output.capacity();
+}
+
+void TranslationCache::Load(const char *file) {
+  util::scoped_fd fd;
+  try {
+    fd.reset(util::OpenReadOrThrow(file));
+  } catch (const util::ErrnoException &e) {
+    return;
+  }
+  const uint64_t size = util::SizeOrThrow(fd.get());
+  if (size < sizeof(kMagic) + sizeof(uint64_t)) return;
+  util::scoped_memory mem;
+  util::MapRead(util::LAZY, fd.get(), 0, size, mem);
+  const char *ptr = static_cast<const char*>(mem.get());
+  const char *const end = ptr + size;
+  UTIL_THROW_IF2(memcmp(ptr, kMagicPrefix, sizeof(kMagicPrefix) - 1), "File " << file << " is not a translation cache.");
+  if (memcmp(ptr, kMagic, sizeof(kMagic))) {
+    std::cerr << "Ignoring translation cache " << file << " from another version." << std::endl;
+    return;
+  }
+  ptr += sizeof(kMagic);
+  uint64_t fingerprint;
+  memcpy(&fingerprint, ptr, sizeof(uint64_t));
+  ptr += sizeof(uint64_t);
+  UTIL_THROW_IF2(fingerprint != fingerprint_, "Translation cache " << file << " was saved with other models, weights or options.  Delete it or pass another --translation-cache-file.");
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  while (ptr != end) {
+    Record record;
+    UTIL_THROW_IF2(end - ptr < (std::ptrdiff_t)sizeof(Record), "Truncated translation cache " << file);
+    memcpy(&record, ptr, sizeof(Record));
+    ptr += sizeof(Record);
+    UTIL_THROW_IF2((uint64_t)(end - ptr) < (uint64_t)record.input_length + record.length, "Truncated translation cache " << file);
+    InsertLocked(record.key, StringPiece(ptr, record.input_length), StringPiece(ptr + record.input_length, record.length), record.score);
+    ptr += record.input_length + record.length;
+  }
+}
+
+void TranslationCache::Save(const char *file) {
+  // Write a temporary file in the same directory and rename it into place, so
+  // a save that fails or is interrupted leaves any previous file intact.
+  std::string temp(file);
+  temp += ".XXXXXX";
+  util::scoped_fd fd(mkstemp(&temp[0]));
+  UTIL_THROW_IF(fd.get() == -1, util::ErrnoException, "while creating a temporary file to save " << file);
+  try {
+    // mkstemp makes the file private; give it the permissions creat would.
+    const mode_t mask = umask(0);
+    umask(mask);
+    UTIL_THROW_IF(fchmod(fd.get(), 0666 & ~mask), util::ErrnoException, "while setting permissions of " << temp);
+    {
+      util::FileStream out(fd.get());
+      out.write(kMagic, sizeof(kMagic));
+      out.write(&fingerprint_, sizeof(uint64_t));
+      boost::unique_lock<boost::mutex> lock(mutex_);
+      for (std::list<uint64_t>::const_reverse_iterator i = recency_.rbegin(); i != recency_.rend(); ++i) {
+        const Value &value = map_.find(*i)->second;
+        Record record;
+        memset(&record, 0, sizeof(Record));
+        record.key = *i;
+        record.score = value.score;
+        record.input_length = value.input.size();
+        record.length = value.output.size();
+        out.write(&record, sizeof(Record));
+        out.write(value.input.data(), value.input.size());
+        out.write(value.output.data(), value.output.size());
+      }
+      out.flush();
+    }
+    util::FSyncOrThrow(fd.get());
+    UTIL_THROW_IF(rename(temp.c_str(), file), util::ErrnoException, "while renaming " << temp << " to " << file);
+  } catch (...) {
+    unlink(temp.c_str());
+    throw;
+  }
+}
+
+void TranslationCache::Report(std::ostream &to) {
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  const uint64_t lookups = hits_ + misses_;
+  to << "Translation cache: " << map_.size() << " entries using about " << bytes_ << " of " << max_bytes_
+    << " bytes, " << hits_ << " hits in " << lookups << " lookups";
+  if (lookups) to << " (" << (100.0 * hits_ / lookups) << "%)";
+  to << std::endl;
+}
+
+void TranslationCache::ReportMemory(util::PoolReport &report) {
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  report.AddBytes("translation_cache", bytes_);
+}
+
+} // namespace decode
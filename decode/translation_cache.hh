@@ -0,0 +1,88 @@
+#pragma once
+
+#include "util/pool.hh"
+#include "util/string_piece.hh"
+
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
+
+#include <iosfwd>
+#include <list>
+#include <string>
+
+#include <stdint.h>
+
+namespace decode {
+
+/* Translations of whole input lines, for inputs that repeat.  Keys hash the
+ * input with whitespace normalized together with a fingerprint of everything
+ * else that affects the output (configuration, weights, models).  The
+ * normalized input is stored too, so inputs whose hashes collide miss
+ * instead of sharing a translation.  Holds at
+ * most max_bytes, evicting the least recently used translation.  All methods
+ * lock, so threads decoding different lines can share one cache.
+ */
+class TranslationCache {
+  public:
+    TranslationCache(std::size_t max_bytes, uint64_t fingerprint);
+
+    struct Key {
+      // Input with whitespace normalized.
+      std::string input;
+      uint64_t hash;
+    };
+
+    Key MakeKey(StringPiece input) const;
+
+    // On a hit, copies the translation and its score.
+    bool Find(const Key &key, std::string &output, float &score);
+
+    // Replaces any entry with the same hash.
+    void Insert(const Key &key, StringPiece output, float score);
+
+    // Add translations saved by a run with the same fingerprint.  The file is
+    // read with mmap.  A missing file adds nothing; another fingerprint
+    // throws rather than risk serving stale translations.
+    void Load(const char *file);
+
+    // Write every translation, least recently used first.  The file is
+    // replaced whole, through a temporary file in the same directory.
+    void Save(const char *file);
+
+    // Entries, approximate memory, and hit rate.
+    void Report(std::ostream &to);
+
+    // Adds a translation_cache entry.
+    void ReportMemory(util::PoolReport &report);
+
+  private:
+    struct Value {
+      // Normalized input, to tell inputs with the same hash apart.
+      std::string input;
+      std::string output;
+      float score;
+      // Position in recency_.
+      std::list<uint64_t>::iterator recent;
+    };
+
+    typedef boost::unordered_map<uint64_t, Value> Map;
+
+    // Caller holds mutex_.
+    void InsertLocked(uint64_t hash, StringPiece input, StringPiece output, float score);
+
+    static std::size_t Bytes(const Value &value);
+
+    const std::size_t max_bytes_;
+    const uint64_t fingerprint_;
+
+    boost::mutex mutex_;
+
+    Map map_;
+    // Keys, most recently used first.
+    std::list<uint64_t> recency_;
+
+    std::size_t bytes_;
+    uint64_t hits_, misses_;
+};
+
+} // namespace decode
@@ -0,0 +1,135 @@
+#include "decode/translation_cache.hh"
+
+#include "util/file.hh"
+
+#define BOOST_TEST_MODULE TranslationCacheTest
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+
+#include <dirent.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+namespace decode {
+namespace {
+
+BOOST_AUTO_TEST_CASE(NormalizeAndFind) {
+  TranslationCache cache(1 << 20, 7);
+  BOOST_CHECK_EQUAL(cache.MakeKey("a b").hash, cache.MakeKey(" a  b\t").hash);
+  BOOST_CHECK_EQUAL("a b", cache.MakeKey(" a  b\t").input);
+  BOOST_CHECK(cache.MakeKey("a b").hash != cache.MakeKey("ab").hash);
+  BOOST_CHECK(cache.MakeKey("a b").hash != TranslationCache(1 << 20, 8).MakeKey("a b").hash);
+
+  std::string output;
+  float score;
+  BOOST_CHECK(!cache.Find(cache.MakeKey("a b"), output, score));
+  cache.Insert(cache.MakeKey("a b"), " A B\n", -1.5);
+  BOOST_REQUIRE(cache.Find(cache.MakeKey("a  b"), output, score));
+  BOOST_CHECK_EQUAL(" A B\n", output);
+  BOOST_CHECK_EQUAL(-1.5, score);
+}
+
+BOOST_AUTO_TEST_CASE(Collision) {
+  TranslationCache cache(1 << 20, 7);
+  cache.Insert(cache.MakeKey("a b"), " A B\n", -1.5);
+  // Another input with the same hash.
+  TranslationCache::Key other = cache.MakeKey("a b");
+  other.input = "c d";
+  std::string output;
+  float score;
+  BOOST_CHECK(!cache.Find(other, output, score));
+  cache.Insert(other, " C D\n", -2.5);
+  BOOST_REQUIRE(cache.Find(other, output, score));
+  BOOST_CHECK_EQUAL(" C D\n", output);
+  BOOST_CHECK(!cache.Find(cache.MakeKey("a b"), output, score));
+}
+
+BOOST_AUTO_TEST_CASE(EvictLeastRecent) {
+  // Room for about two short entries.
+  TranslationCache cache(400, 0);
+  std::string output;
+  float score;
+  cache.Insert(cache.MakeKey("1"), "one", 1.0);
+  cache.Insert(cache.MakeKey("2"), "two", 2.0);
+  BOOST_REQUIRE(cache.Find(cache.MakeKey("1"), output, score));
+  cache.Insert(cache.MakeKey("3"), "three", 3.0);
+  BOOST_CHECK(cache.Find(cache.MakeKey("1"), output, score));
+  BOOST_CHECK(!cache.Find(cache.MakeKey("2"), output, score));
+  BOOST_CHECK(cache.Find(cache.MakeKey("3"), output, score));
+}
+
+BOOST_AUTO_TEST_CASE(SaveAndLoad) {
+  util::scoped_fd temp(util::MakeTemp(util::DefaultTempDirectory()));
+  const std::string name(util::NameFromFD(temp.get()));
+  TranslationCache saving(1 << 20, 3);
+  saving.Insert(saving.MakeKey("a b"), " A B\n", -2.0);
+  saving.Insert(saving.MakeKey("c"), "\n", -1.0);
+  saving.Save(name.c_str());
+
+  TranslationCache loading(1 << 20, 3);
+  loading.Load(name.c_str());
+  std::string output;
+  float score;
+  BOOST_REQUIRE(loading.Find(loading.MakeKey("a b"), output, score));
+  BOOST_CHECK_EQUAL(" A B\n", output);
+  BOOST_CHECK_EQUAL(-2.0, score);
+  BOOST_REQUIRE(loading.Find(loading.MakeKey("c"), output, score));
+  BOOST_CHECK_EQUAL("\n", output);
+
+  TranslationCache other(1 << 20, 4);
+  BOOST_CHECK_THROW(other.Load(name.c_str()), util::Exception);
+}
+
+// Names in the directory other than . and ..
+std::size_t CountFiles(const std::string &directory) {
+  DIR *dir = opendir(directory.c_str());
+  BOOST_REQUIRE(dir);
+  std::size_t count = 0;
+  while (const struct dirent *entry = readdir(dir)) {
+    const std::string name(entry->d_name);
+    if (name != "." && name != "..") ++count;
+  }
+  closedir(dir);
+  return count;
+}
+
+BOOST_AUTO_TEST_CASE(SaveReplaces) {
+  std::string directory = util::DefaultTempDirectory() + "translation_cache_test_XXXXXX";
+  BOOST_REQUIRE(mkdtemp(&directory[0]));
+  const std::string name = directory + "/cache";
+  util::scoped_fd stale(util::CreateOrThrow(name.c_str()));
+  util::WriteOrThrow(stale.get(), "stale", 5);
+
+  TranslationCache first(1 << 20, 3);
+  first.Insert(first.MakeKey("a"), " A\n", -1.0);
+  first.Save(name.c_str());
+  TranslationCache second(1 << 20, 3);
+  second.Insert(second.MakeKey("b"), " B\n", -2.0);
+  second.Save(name.c_str());
+  // The temporary files were renamed over the cache, so a reader of the old
+  // file, such as a mapping by Load, still sees it whole.
+  BOOST_CHECK_EQUAL(1U, CountFiles(directory));
+  char buffer[5];
+  util::SeekOrThrow(stale.get(), 0);
+  BOOST_REQUIRE_EQUAL(5U, util::ReadOrEOF(stale.get(), buffer, 5));
+  BOOST_CHECK_EQUAL("stale", std::string(buffer, 5));
+
+  TranslationCache loading(1 << 20, 3);
+  loading.Load(name.c_str());
+  std::string output;
+  float score;
+  BOOST_CHECK(!loading.Find(loading.MakeKey("a"), output, score));
+  BOOST_REQUIRE(loading.Find(loading.MakeKey("b"), output, score));
+  BOOST_CHECK_EQUAL(" B\n", output);
+
+  // Nowhere to write the temporary file.
+  TranslationCache failing(1 << 20, 3);
+  BOOST_CHECK_THROW(failing.Save((directory + "/missing/cache").c_str()), util::ErrnoException);
+
+  BOOST_CHECK(!unlink(name.c_str()));
+  BOOST_CHECK(!rmdir(directory.c_str()));
+}
+
+} // namespace
+} // namespace decode
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <boost/unordered_set.hpp>
+
 #include <stdint.h>
 
 // TODO replace with decode-local type
@@ -11,4 +13,7 @@ enum class TargetPhraseType : uint8_t {
   Table, Passthrough, Begin, EOS
 };
 
+// Phrase table rows, identified by address.
+typedef boost::unordered_set<const pt::Row*> RowSet;
+
 } // namespace decode
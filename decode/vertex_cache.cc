@@ -0,0 +1,133 @@
+#include "decode/vertex_cache.hh"
+
+#include "util/murmur_hash.hh"
+
+#include <algorithm>
+#include <iostream>
+
+#include <assert.h>
+
+namespace decode {
+
+namespace {
+const std::size_t kSightingsSize = 1 << 20;
+const uint8_t kMaxSightings = 255;
+} // namespace
+
+VertexCache::VertexCache()
+  : clock_hand_(0), sightings_(kSightingsSize), sightings_since_aging_(0), bytes_(0),
+    hits_(0), misses_(0), admissions_(0), evictions_(0) {}
+
+VertexCache::VertexCache(const Config &config)
+  : config_(config), clock_hand_(0), sightings_(config.max_bytes ? kSightingsSize : 0), sightings_since_aging_(0), bytes_(0),
+    hits_(0), misses_(0), admissions_(0), evictions_(0) {}
+
+unsigned int VertexCache::Sighting(uint64_t hash) {
+  uint8_t &count = sightings_[hash & (kSightingsSize - 1)];
+  if (count != kMaxSightings) ++count;
+  unsigned int ret = count;
+  if (++sightings_since_aging_ == 10 * kSightingsSize) {
+    for (std::vector<uint8_t>::iterator i = sightings_.begin(); i != sightings_.end(); ++i) {
+      *i >>= 1;
+    }
+    sightings_since_aging_ = 0;
+  }
+  return ret;
+}
+
+VertexCache::Entry *VertexCache::Acquire(const ID *begin, const ID *end) {
+  if (!config_.max_bytes) return NULL;
+  const uint64_t hash = util::MurmurHashNative(begin, (end - begin) * sizeof(ID));
+  Map::iterator found = map_.find(hash);
+  if (found != map_.end()) {
+    Entry &entry = found->second;
+    // A different phrase with the same hash is left uncached.
+    if (entry.words_.size() != static_cast<std::size_t>(end - begin) || !std::equal(begin, end, entry.words_.begin())) {
+      ++misses_;
+      return NULL;
+    }
+    ++hits_;
+    entry.referenced_ = true;
+    ++entry.pins_;
+    return &entry;
+  }
+  ++misses_;
+  if (Sighting(hash) < config_.admit_count) return NULL;
+  ++admissions_;
+  Entry &entry = map_[hash];
+  clock_.push_back(hash);
+  entry.words_.assign(begin, end);
+  entry.pins_ = 1;
+  return &entry;
+}
+
+std::size_t VertexCache::Measure(const Entry &entry) {
+  return sizeof(Map::value_type) + 2 * sizeof(void*) /* node and bucket */
+    + sizeof(uint64_t) /* clock_ */
+    + entry.words_.capacity() * sizeof(ID)
+    + entry.vertex.MemoryBytes()
+    + entry.pool.Stats().page_bytes;
+}
+
+void VertexCache::Loaded(Entry &entry) {
+  entry.loaded_ = true;
+  entry.bytes_ = Measure(entry);
+  bytes_ += entry.bytes_;
+  if (bytes_ > config_.max_bytes) Evict();
+}
+
+void VertexCache::Release(Entry &entry) {
+  assert(entry.pins_);
+  --entry.pins_;
+  if (!entry.loaded_) return;
+  const std::size_t bytes = Measure(entry);
+  bytes_ = bytes_ - entry.bytes_ + bytes;
+  entry.bytes_ = bytes;
+  if (bytes_ > config_.max_bytes) Evict();
+}
+
+void VertexCache::Evict() {
+  // Give up after two sweeps of the clock find nothing to evict.
+  std::size_t unproductive = 0;
+  while (bytes_ > config_.max_bytes && !clock_.empty() && unproductive < 2 * clock_.size()) {
+    if (clock_hand_ >= clock_.size()) clock_hand_ = 0;
+    Map::iterator found = map_.find(clock_[clock_hand_]);
+    Entry &entry = found->second;
+    if (entry.pins_ || !entry.loaded_) {
+      ++clock_hand_;
+      ++unproductive;
+    } else if (entry.referenced_) {
+      entry.referenced_ = false;
+      ++clock_hand_;
+      ++unproductive;
+    } else {
+      bytes_ -= entry.bytes_;
+      map_.erase(found);
+      clock_[clock_hand_] = clock_.back();
+      clock_.pop_back();
+      ++evictions_;
+      unproductive = 0;
+    }
+  }
+}
+
+void VertexCache::Report(std::ostream &to) const {
+  const uint64_t lookups = hits_ + misses_;
+  to << "Vertex cache: " << map_.size() << " entries using about " << bytes_ << " of " << config_.max_bytes
+    << " bytes, " << hits_ << " hits in " << lookups << " lookups";
+  if (lookups) to << " (" << (100.0 * hits_ / lookups) << "%)";
+  to << ", " << admissions_ << " admitted, " << evictions_ << " evicted" << std::endl;
+}
+
+void VertexCache::ReportMemory(util::PoolReport &report) const {
+  std::size_t target_phrases = 0;
+  for (Map::const_iterator i = map_.begin(); i != map_.end(); ++i) {
+    if (!i->second.loaded_) continue;
+    report.Add("vertex_cache/target_phrases", i->second.pool);
+    target_phrases += i->second.pool.Stats().page_bytes;
+  }
+  report.AddBytes("vertex_cache/entries", bytes_ - target_phrases);
+  report.AddBytes("vertex_cache/admission", sightings_.capacity());
+}
+
+} // namespace decode
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "decode/id.hh"
+#include "search/vertex.hh"
+#include "util/pool.hh"
+
+#include <boost/unordered_map.hpp>
+
+#include <iosfwd>
+#include <vector>
+
+#include <stdint.h>
+
+namespace decode {
+
+/* Target phrases of source phrases that recur across sentences, so they are
+ * looked up and scored once.  Memory is capped: a source phrase is admitted
+ * once it has been seen admit_count times, and when the cache grows past
+ * max_bytes whole entries (vertex and target phrases) are evicted with the
+ * CLOCK policy.  Entries in use by a Chart are pinned and never evicted, so
+ * the cap can be exceeded while every entry is in use.
+ *
+ * Keys are words of the phrase table vocabulary.  Only the thread calling
+ * Chart::LoadPhrases touches the cache itself; loading threads fill the
+ * vertex and pool of the entries they were handed.
+ */
+class VertexCache {
+  public:
+    struct Config {
+      // 0 disables the cache.
+      std::size_t max_bytes = 256 << 20;
+      // Times a phrase is seen before it is cached.
+      unsigned int admit_count = 2;
+    };
+
+    class Entry {
+      public:
+        Entry() : loaded_(false), referenced_(false), pins_(0), bytes_(0) {}
+
+        // Whether vertex holds the target phrases.  Those might be none.
+        bool Loaded() const { return loaded_; }
+
+        search::Vertex vertex;
+        // Backs the target phrases in vertex.
+        util::Pool pool;
+
+      private:
+        friend class VertexCache;
+        std::vector<ID> words_;
+        bool loaded_;
+        // CLOCK reference bit.
+        bool referenced_;
+        unsigned int pins_;
+        std::size_t bytes_;
+    };
+
+    VertexCache();
+
+    explicit VertexCache(const Config &config);
+
+    // Pinned entry for the phrase or NULL if it is not (yet) cached.
+    Entry *Acquire(const ID *begin, const ID *end);
+
+    // After loading the target phrases of an entry returned by Acquire.
+    // May evict other entries.
+    void Loaded(Entry &entry);
+
+    // After a Chart is done with an entry.  Search grows the split tree of
+    // the vertex, so the entry is measured again and may evict others.
+    void Release(Entry &entry);
+
+    // Bytes charged against max_bytes.
+    std::size_t Bytes() const { return bytes_; }
+
+    // Hit rate, admissions, evictions and memory.
+    void Report(std::ostream &to) const;
+
+    // Adds vertex_cache/* entries.
+    void ReportMemory(util::PoolReport &report) const;
+
+  private:
+    typedef boost::unordered_map<uint64_t, Entry> Map;
+
+    // Count a sighting of the phrase and return the number so far.
+    unsigned int Sighting(uint64_t hash);
+
+    // Bytes the entry takes, including the split tree grown so far.
+    static std::size_t Measure(const Entry &entry);
+
+    void Evict();
+
+    const Config config_;
+
+    Map map_;
+
+    // Keys of entries in CLOCK order, with the hand at clock_hand_.
+    std::vector<uint64_t> clock_;
+    std::size_t clock_hand_;
+
+    // Saturating counts of sightings by hash, halved periodically so that
+    // only recent frequency counts.
+    std::vector<uint8_t> sightings_;
+    std::size_t sightings_since_aging_;
+
+    std::size_t bytes_;
+
+    uint64_t hits_, misses_, admissions_, evictions_;
+};
+
+} // namespace decode
@@ -0,0 +1,134 @@
+#include "decode/vertex_cache.hh"
+
+#define BOOST_TEST_MODULE VertexCacheTest
+#include <boost/test/unit_test.hpp>
+
+namespace decode {
+namespace {
+
+BOOST_AUTO_TEST_CASE(Admission) {
+  VertexCache::Config config;
+  config.admit_count = 2;
+  VertexCache cache(config);
+  const ID phrase[2] = {5, 6};
+  BOOST_CHECK(!cache.Acquire(phrase, phrase + 2));
+  VertexCache::Entry *entry = cache.Acquire(phrase, phrase + 2);
+  BOOST_REQUIRE(entry);
+  BOOST_CHECK(!entry->Loaded());
+  cache.Loaded(*entry);
+  cache.Release(*entry);
+  VertexCache::Entry *again = cache.Acquire(phrase, phrase + 2);
+  BOOST_CHECK_EQUAL(entry, again);
+  BOOST_CHECK(again->Loaded());
+  cache.Release(*again);
+  // A prefix is a different phrase.
+  BOOST_CHECK(!cache.Acquire(phrase, phrase + 1));
+}
+
+BOOST_AUTO_TEST_CASE(Disabled) {
+  VertexCache::Config config;
+  config.max_bytes = 0;
+  config.admit_count = 1;
+  VertexCache cache(config);
+  const ID phrase[1] = {3};
+  BOOST_CHECK(!cache.Acquire(phrase, phrase + 1));
+}
+
+BOOST_AUTO_TEST_CASE(EvictUnpinned) {
+  VertexCache::Config config;
+  config.max_bytes = 3000;
+  config.admit_count = 1;
+  VertexCache cache(config);
+  ID words[1];
+  std::vector<VertexCache::Entry*> entries;
+  for (ID i = 0; i < 3; ++i) {
+    words[0] = i;
+    VertexCache::Entry *entry = cache.Acquire(words, words + 1);
+    BOOST_REQUIRE(entry);
+    entry->pool.Allocate(1000);
+    entries.push_back(entry);
+  }
+  // All are pinned so none can be evicted even though the cap is exceeded.
+  for (std::size_t i = 0; i < 3; ++i) {
+    cache.Loaded(*entries[i]);
+  }
+  words[0] = 0;
+  BOOST_CHECK_EQUAL(entries[0], cache.Acquire(words, words + 1));
+  cache.Release(*entries[0]);
+  // Release all but entry 2, then add another entry to force eviction.
+  cache.Release(*entries[0]);
+  cache.Release(*entries[1]);
+  words[0] = 3;
+  VertexCache::Entry *fresh = cache.Acquire(words, words + 1);
+  BOOST_REQUIRE(fresh);
+  cache.Loaded(*fresh);
+  // Entry 2 is pinned and fresh is pinned; 0 and 1 are gone.
+  words[0] = 2;
+  BOOST_CHECK_EQUAL(entries[2], cache.Acquire(words, words + 1));
+  words[0] = 3;
+  BOOST_CHECK_EQUAL(fresh, cache.Acquire(words, words + 1));
+  words[0] = 0;
+  VertexCache::Entry *readmitted = cache.Acquire(words, words + 1);
+  BOOST_REQUIRE(readmitted);
+  BOOST_CHECK(!readmitted->Loaded());
+}
+
+// Hypotheses that split into one child each.
+void FillVertex(std::size_t count, search::Vertex &vertex) {
+  vertex.InitRoot();
+  for (std::size_t i = 0; i < count; ++i) {
+    search::HypoState hypo;
+    hypo.history.vp = NULL;
+    hypo.state.left.full = false;
+    hypo.state.left.length = 1;
+    hypo.state.left.pointers[0] = i + 1;
+    hypo.state.right.length = 0;
+    hypo.score = -static_cast<float>(i);
+    vertex.AppendHypothesis(hypo);
+  }
+  vertex.FinishRoot(search::kPolicyLeft);
+}
+
+// Search splits cached vertices long after they were loaded.
+BOOST_AUTO_TEST_CASE(SplitTreeCounts) {
+  const std::size_t hypos = 1000;
+  VertexCache::Config config;
+  config.max_bytes = 1024 * sizeof(search::HypoState) + 8192;
+  config.admit_count = 1;
+  VertexCache cache(config);
+  const ID phrase[1] = {7};
+  VertexCache::Entry *entry = cache.Acquire(phrase, phrase + 1);
+  BOOST_REQUIRE(entry);
+  FillVertex(hypos, entry->vertex);
+  cache.Loaded(*entry);
+  const std::size_t loaded = cache.Bytes();
+  BOOST_REQUIRE(loaded <= config.max_bytes);
+
+  // One child per hypothesis.
+  entry->vertex.Root().BuildExtend();
+  BOOST_REQUIRE_EQUAL(hypos, entry->vertex.Root().Size());
+  BOOST_REQUIRE(loaded + hypos * sizeof(search::VertexNode) > config.max_bytes);
+  cache.Release(*entry);
+  BOOST_CHECK(cache.Bytes() <= config.max_bytes);
+  VertexCache::Entry *readmitted = cache.Acquire(phrase, phrase + 1);
+  BOOST_REQUIRE(readmitted);
+  BOOST_CHECK(!readmitted->Loaded());
+}
+
+BOOST_AUTO_TEST_CASE(SplitTreeGrows) {
+  VertexCache::Config config;
+  config.admit_count = 1;
+  VertexCache cache(config);
+  const ID phrase[1] = {7};
+  VertexCache::Entry *entry = cache.Acquire(phrase, phrase + 1);
+  BOOST_REQUIRE(entry);
+  FillVertex(100, entry->vertex);
+  cache.Loaded(*entry);
+  const std::size_t loaded = cache.Bytes();
+  entry->vertex.Root().BuildExtend();
+  cache.Release(*entry);
+  BOOST_CHECK_GE(cache.Bytes(), loaded + 100 * sizeof(search::VertexNode));
+}
+
+} // namespace
+} // namespace decode
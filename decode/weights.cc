@@ -69,6 +69,9 @@ std::vector<float> Weights::GetWeights(const StringPiece name) const {
 	return it->second;
 }
 
+bool Weights::HasWeights(const StringPiece name) const {
+	return FindStringPiece(weights_map_, name) != weights_map_.end();
+}
 
 float Weights::GetSingleWeight(const StringPiece name) const {
 	WeightsMap::const_iterator it = FindStringPiece(weights_map_, name);
@@ -26,6 +26,8 @@ public:
 	 float TargetWordInsertionWeight() const { return target_word_insertion_weight_; }
 	 
 	 std::vector<float> GetWeights(const StringPiece name) const;
+
+	 bool HasWeights(const StringPiece name) const;
 private:
 
 	 // MRK: TODO: this class is a bit confused right now.
@@ -0,0 +1,45 @@
+#include "decode/workers.hh"
+
+#include <algorithm>
+#include <vector>
+
+#include <assert.h>
+
+namespace decode {
+
+struct Workers::Job {
+  const Task *task;
+  std::size_t worker;
+  util::Semaphore *done;
+};
+
+void Workers::Handler::operator()(Job *job) const {
+  (*job->task)(job->worker);
+  job->done->post();
+}
+
+Workers::Workers(std::size_t threads) : threads_(std::max<std::size_t>(1, threads)) {
+  if (threads_ > 1) {
+    pool_.reset(new util::ThreadPool<Handler>(threads_, threads_ - 1, Handler(), NULL));
+  }
+}
+
+Workers::~Workers() {}
+
+void Workers::Run(std::size_t count, const Task &task) {
+  assert(count && count <= threads_);
+  util::Semaphore done(0);
+  std::vector<Job> jobs(count);
+  for (std::size_t worker = 1; worker < count; ++worker) {
+    jobs[worker].task = &task;
+    jobs[worker].worker = worker;
+    jobs[worker].done = &done;
+    pool_->Produce(&jobs[worker]);
+  }
+  task(0);
+  for (std::size_t worker = 1; worker < count; ++worker) {
+    util::WaitSemaphore(done);
+  }
+}
+
+} // namespace decode
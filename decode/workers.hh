@@ -0,0 +1,45 @@
+#pragma once
+
+#include "util/thread_pool.hh"
+
+#include <boost/function.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include <cstddef>
+
+namespace decode {
+
+/* Threads that live as long as the System, so charts and stacks hand them
+ * blocks of work instead of starting threads for every sentence or stack.
+ * The calling thread counts as one of them.
+ */
+class Workers {
+  public:
+    typedef boost::function<void (std::size_t)> Task;
+
+    explicit Workers(std::size_t threads);
+
+    ~Workers();
+
+    std::size_t Threads() const { return threads_; }
+
+    // Run task(worker) for each worker in [0, count): 0 on the calling thread
+    // and the others on the pool.  Returns once all are done.  count may not
+    // exceed Threads().  Only one thread may call this at a time.
+    void Run(std::size_t count, const Task &task);
+
+    struct Job;
+
+  private:
+    struct Handler {
+      typedef Job *Request;
+      void operator()(Job *job) const;
+    };
+
+    const std::size_t threads_;
+
+    // NULL with one thread.
+    boost::scoped_ptr<util::ThreadPool<Handler> > pool_;
+};
+
+} // namespace decode
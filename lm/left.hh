@@ -155,6 +155,14 @@ template <class M> class RuleScore {
       return prob_;
     }
 
+    // Continue from where other left off, keeping this scorer's output.
+    // Rules that share a prefix of terminals can then score it once.
+    void Branch(const RuleScore<M> &other) {
+      *out_ = *other.out_;
+      left_done_ = other.left_done_;
+      prob_ = other.prob_;
+    }
+
     void Reset() {
       prob_ = 0.0;
       left_done_ = false;
@@ -1,5 +1,6 @@
 #include "lm/left.hh"
 #include "lm/model.hh"
+#include "lm/terminal_batch.hh"
 
 #include "util/tokenize_piece.hh"
 
@@ -356,6 +357,81 @@ const char *FileLocation() {
   return boost::unit_test::framework::master_test_suite().argv[1];
 }
 
+// Scoring a shared prefix once and branching gives the same as scoring
+// each rule on its own.
+template <class M> void Branch(const M &m) {
+  const char *const kRules[] = {"looking on a little", "looking on more", "looking"};
+  ChartState alone[3];
+  float alone_score[3];
+  for (unsigned i = 0; i < 3; ++i) {
+    RuleScore<M> score(m, alone[i]);
+    for (util::TokenIter<util::SingleCharacter, true> word(kRules[i], ' '); word; ++word) {
+      Term(*word);
+    }
+    alone_score[i] = score.Finish();
+  }
+
+  ChartState prefix_state, branched[3];
+  RuleScore<M> prefix(m, prefix_state);
+  prefix.Terminal(m.GetVocabulary().Index("looking"));
+  {
+    RuleScore<M> score(m, branched[2]);
+    score.Branch(prefix);
+    BOOST_CHECK_EQUAL(alone_score[2], score.Finish());
+  }
+  prefix.Terminal(m.GetVocabulary().Index("on"));
+  {
+    RuleScore<M> score(m, branched[0]);
+    score.Branch(prefix);
+    Term("a");
+    Term("little");
+    BOOST_CHECK_EQUAL(alone_score[0], score.Finish());
+  }
+  {
+    RuleScore<M> score(m, branched[1]);
+    score.Branch(prefix);
+    Term("more");
+    BOOST_CHECK_EQUAL(alone_score[1], score.Finish());
+  }
+  for (unsigned i = 0; i < 3; ++i) {
+    BOOST_CHECK(alone[i] == branched[i]);
+  }
+}
+
+// Batches give the same as scoring each rule, with and without prefetching.
+template <class M> void Batch(const M &m) {
+  const char *const kRules[] = {"looking on a little", "looking on more", "looking", "", "on a little", "looking on more", "little more loin"};
+  const std::size_t kCount = sizeof(kRules) / sizeof(const char*);
+  ChartState alone[kCount];
+  float alone_score[kCount];
+  std::vector<std::vector<WordIndex> > words(kCount);
+  for (std::size_t i = 0; i < kCount; ++i) {
+    RuleScore<M> score(m, alone[i]);
+    for (util::TokenIter<util::SingleCharacter, true> word(kRules[i], ' '); word; ++word) {
+      words[i].push_back(m.GetVocabulary().Index(*word));
+      score.Terminal(words[i].back());
+    }
+    alone_score[i] = score.Finish();
+  }
+  for (std::size_t group = 1; group < 4; group += 2) {
+    TerminalBatch<M> batch(m, group);
+    // Twice to check that scratch is reset.
+    for (unsigned repeat = 0; repeat < 2; ++repeat) {
+      for (std::size_t i = 0; i < kCount; ++i) {
+        batch.Add(words[i].empty() ? NULL : &words[i][0], words[i].empty() ? NULL : &words[i][0] + words[i].size());
+      }
+      BOOST_REQUIRE_EQUAL(kCount, batch.Size());
+      ChartState states[kCount];
+      float scores[kCount];
+      batch.Finish(states, scores);
+      for (std::size_t i = 0; i < kCount; ++i) {
+        BOOST_CHECK_EQUAL(alone_score[i], scores[i]);
+        BOOST_CHECK(alone[i] == states[i]);
+      }
+    }
+  }
+}
+
 template <class M> void Everything() {
   Config config;
   config.messages = NULL;
@@ -367,6 +443,8 @@ template <class M> void Everything() {
   AlsoWouldConsiderHigher(m);
   GrowSmall(m);
   FullGrow(m);
+  Branch(m);
+  Batch(m);
 }
 
 BOOST_AUTO_TEST_CASE(ProbingAll) {
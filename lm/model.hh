@@ -93,6 +93,14 @@ template <class Search, class VocabularyT> class GenericModel : public base::Mod
         // Amount of additional content that should be considered by the next call.
         unsigned char &next_use) const;
 
+    /* Start loading what FullScore(in_state, new_word, ...) will read, so
+     * independent scorings can overlap their cache misses.  Only the probing
+     * models load anything.
+     */
+    void Prefetch(const State &in_state, const WordIndex new_word) const {
+      search_.Prefetch(new_word, in_state.words, in_state.words + in_state.length);
+    }
+
     /* Return probabilities minus rest costs for an array of pointers.  The
      * first length should be the length of the n-gram to which pointers_begin
      * points.
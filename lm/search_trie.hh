@@ -74,6 +74,9 @@ template <class Quant, class Bhiksha> class TrieSearch {
       return ret;
     }
 
+    // Each trie lookup depends on the one before, so nothing can load early.
+    void Prefetch(WordIndex, const WordIndex *, const WordIndex *) const {}
+
     MiddlePointer Unpack(uint64_t extend_pointer, unsigned char extend_length, Node &node) const {
       return MiddlePointer(quant_, extend_length - 2, middle_begin_[extend_length - 2].ReadEntry(extend_pointer, node));
     }
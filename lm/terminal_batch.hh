@@ -0,0 +1,143 @@
+#ifndef LM_TERMINAL_BATCH_H
+#define LM_TERMINAL_BATCH_H
+
+#include "lm/left.hh"
+#include "lm/state.hh"
+#include "lm/word_index.hh"
+
+#include <algorithm>
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+namespace lm {
+namespace ngram {
+
+/* Scores rules made only of terminals, such as the target phrases of one
+ * source span, with the same states and scores as RuleScore on each rule.
+ * Rules are sorted so a prefix several of them share is scored once.  Words
+ * at the same depth do not depend on each other, so they are scored in
+ * groups: every lookup in a group is prefetched before any is scored, which
+ * overlaps their cache misses when the model is larger than the cache.
+ */
+template <class M> class TerminalBatch {
+  public:
+    // group is how many words to prefetch before scoring them.  1 scores
+    // each word without prefetching.
+    explicit TerminalBatch(const M &model, std::size_t group = 1)
+      : model_(model), group_(std::max<std::size_t>(1, group)), offsets_(1, 0) {}
+
+    void Add(const WordIndex *begin, const WordIndex *end) {
+      words_.insert(words_.end(), begin, end);
+      offsets_.push_back(words_.size());
+    }
+
+    std::size_t Size() const { return offsets_.size() - 1; }
+
+    // Score the rules in the order they were added, writing Size() states and
+    // scores, and forget them.
+    void Finish(ChartState *states, float *scores) {
+      BuildTrie();
+      node_states_.resize(nodes_.size());
+      scorers_.clear();
+      for (std::size_t i = 0; i < nodes_.size(); ++i) {
+        scorers_.push_back(RuleScore<M>(model_, node_states_[i]));
+      }
+      for (std::size_t depth = 1; depth < levels_.size(); ++depth) {
+        const std::vector<std::size_t> &level = levels_[depth];
+        for (std::size_t group = 0; group < level.size(); group += group_) {
+          const std::size_t group_end = std::min(level.size(), group + group_);
+          for (std::size_t i = group; i < group_end; ++i) {
+            const Node &node = nodes_[level[i]];
+            scorers_[level[i]].Branch(scorers_[node.parent]);
+            if (group_ > 1) model_.Prefetch(node_states_[level[i]].right, node.word);
+          }
+          for (std::size_t i = group; i < group_end; ++i) {
+            scorers_[level[i]].Terminal(nodes_[level[i]].word);
+          }
+        }
+      }
+      for (std::size_t rule = 0; rule < Size(); ++rule) {
+        scores[rule] = scorers_[rule_nodes_[rule]].Finish();
+        states[rule] = node_states_[rule_nodes_[rule]];
+      }
+      words_.clear();
+      offsets_.resize(1);
+    }
+
+  private:
+    // Prefixes of the rules.  Node 0 is the empty prefix.
+    struct Node {
+      std::size_t parent;
+      WordIndex word;
+    };
+
+    class RuleLess {
+      public:
+        explicit RuleLess(const TerminalBatch<M> &batch) : batch_(batch) {}
+
+        bool operator()(std::size_t a, std::size_t b) const {
+          return std::lexicographical_compare(
+              batch_.words_.begin() + batch_.offsets_[a], batch_.words_.begin() + batch_.offsets_[a + 1],
+              batch_.words_.begin() + batch_.offsets_[b], batch_.words_.begin() + batch_.offsets_[b + 1]);
+        }
+
+      private:
+        const TerminalBatch<M> &batch_;
+    };
+
+    // Sort the rules and give each distinct prefix a node, listing the nodes
+    // of each length in levels_.
+    void BuildTrie() {
+      order_.resize(Size());
+      for (std::size_t i = 0; i < order_.size(); ++i) order_[i] = i;
+      std::sort(order_.begin(), order_.end(), RuleLess(*this));
+
+      nodes_.resize(1);
+      levels_.resize(1);
+      for (std::size_t i = 0; i < levels_.size(); ++i) levels_[i].clear();
+      rule_nodes_.resize(Size());
+      // path_[d] is the node for the first d words of the previous rule.
+      path_.resize(1);
+      path_[0] = 0;
+      std::size_t previous_begin = 0, previous_length = 0;
+      for (std::size_t i = 0; i < order_.size(); ++i) {
+        const std::size_t begin = offsets_[order_[i]], length = offsets_[order_[i] + 1] - begin;
+        std::size_t shared = 0;
+        while (shared < std::min(length, previous_length) && words_[begin + shared] == words_[previous_begin + shared]) ++shared;
+        path_.resize(length + 1);
+        if (levels_.size() < length + 1) levels_.resize(length + 1);
+        for (std::size_t depth = shared; depth < length; ++depth) {
+          Node node;
+          node.parent = path_[depth];
+          node.word = words_[begin + depth];
+          path_[depth + 1] = nodes_.size();
+          levels_[depth + 1].push_back(nodes_.size());
+          nodes_.push_back(node);
+        }
+        rule_nodes_[order_[i]] = path_[length];
+        previous_begin = begin;
+        previous_length = length;
+      }
+    }
+
+    const M &model_;
+    const std::size_t group_;
+
+    // Rule i is words_[offsets_[i], offsets_[i + 1]).
+    std::vector<WordIndex> words_;
+    std::vector<std::size_t> offsets_;
+
+    // Scratch reused between batches.
+    std::vector<std::size_t> order_, path_, rule_nodes_;
+    std::vector<Node> nodes_;
+    std::vector<std::vector<std::size_t> > levels_;
+    std::vector<ChartState> node_states_;
+    // RuleScore is not assignable, which std::vector requires before C++11.
+    std::deque<RuleScore<M> > scorers_;
+};
+
+} // namespace ngram
+} // namespace lm
+
+#endif // LM_TERMINAL_BATCH_H
@@ -0,0 +1,132 @@
+#include "perf/baseline.hh"
+
+#include "util/exception.hh"
+
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+namespace perf {
+namespace {
+
+class Parser {
+  public:
+    Parser(const std::string &text, const std::string &file) : text_(text), file_(file), pos_(0) {}
+
+    void Expect(char c) {
+      SkipSpace();
+      UTIL_THROW_IF(pos_ >= text_.size() || text_[pos_] != c, util::Exception, "Expected '" << c << "' at byte " << pos_ << " of " << file_);
+      ++pos_;
+    }
+
+    // Consume c if it is next.
+    bool Accept(char c) {
+      SkipSpace();
+      if (pos_ < text_.size() && text_[pos_] == c) {
+        ++pos_;
+        return true;
+      }
+      return false;
+    }
+
+    // No escapes.
+    std::string String() {
+      Expect('"');
+      std::size_t end = text_.find('"', pos_);
+      UTIL_THROW_IF(end == std::string::npos, util::Exception, "Unterminated string in " << file_);
+      std::string ret(text_, pos_, end - pos_);
+      pos_ = end + 1;
+      return ret;
+    }
+
+    double Number() {
+      SkipSpace();
+      const char *begin = text_.c_str() + pos_;
+      char *end;
+      double ret = std::strtod(begin, &end);
+      UTIL_THROW_IF(end == begin, util::Exception, "Expected a number at byte " << pos_ << " of " << file_);
+      pos_ += end - begin;
+      return ret;
+    }
+
+    bool Done() {
+      SkipSpace();
+      return pos_ == text_.size();
+    }
+
+  private:
+    void SkipSpace() {
+      while (pos_ < text_.size() && std::isspace(static_cast<unsigned char>(text_[pos_]))) ++pos_;
+    }
+
+    const std::string &text_;
+    const std::string &file_;
+    std::size_t pos_;
+};
+
+} // namespace
+
+Baseline::Baseline(const std::string &file) {
+  std::ifstream in(file.c_str());
+  UTIL_THROW_IF(!in, util::ErrnoException, "Could not open baseline " << file);
+  const std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  Parser parser(text, file);
+  parser.Expect('{');
+  if (!parser.Accept('}')) {
+    do {
+      const std::string name = parser.String();
+      parser.Expect(':');
+      parser.Expect('{');
+      Expected expected;
+      expected.baseline = -1.0;
+      expected.tolerance = 0.0;
+      do {
+        const std::string key = parser.String();
+        parser.Expect(':');
+        const double value = parser.Number();
+        if (key == "baseline") {
+          expected.baseline = value;
+        } else if (key == "tolerance") {
+          expected.tolerance = value;
+        } else {
+          UTIL_THROW(util::Exception, "Unknown key " << key << " for " << name << " in " << file);
+        }
+      } while (parser.Accept(','));
+      parser.Expect('}');
+      UTIL_THROW_IF(expected.baseline < 0.0, util::Exception, "No baseline for " << name << " in " << file);
+      UTIL_THROW_IF(expected.tolerance < 0.0 || expected.tolerance > 1.0, util::Exception, "Tolerance for " << name << " in " << file << " should be in [0, 1]");
+      expected_[name] = expected;
+    } while (parser.Accept(','));
+    parser.Expect('}');
+  }
+  UTIL_THROW_IF(!parser.Done(), util::Exception, "Trailing content in " << file);
+}
+
+const Baseline::Expected &Baseline::Find(const std::string &name) const {
+  std::map<std::string, Expected>::const_iterator i = expected_.find(name);
+  UTIL_THROW_IF(i == expected_.end(), util::Exception, "No baseline for " << name);
+  return i->second;
+}
+
+bool Baseline::Check(const std::string &name, double measured, std::ostream &to) const {
+  const Expected &expected = Find(name);
+  const double minimum = expected.baseline * (1.0 - expected.tolerance);
+  const bool pass = measured >= minimum;
+  to << name << ": " << measured << " (baseline " << expected.baseline << ", "
+    << (expected.baseline > 0.0 ? measured / expected.baseline : 0.0) << "x, minimum " << minimum << ") "
+    << (pass ? "ok" : "SLOWER THAN BASELINE") << std::endl;
+  return pass;
+}
+
+void WriteBaseline(const std::map<std::string, double> &measured, double tolerance, std::ostream &to) {
+  to << "{\n";
+  for (std::map<std::string, double>::const_iterator i = measured.begin(); i != measured.end(); ++i) {
+    if (i != measured.begin()) to << ",\n";
+    to << "  \"" << i->first << "\": {\"baseline\": " << i->second << ", \"tolerance\": " << tolerance << "}";
+  }
+  to << "\n}\n";
+}
+
+} // namespace perf
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <iosfwd>
+#include <map>
+#include <string>
+
+namespace perf {
+
+/* Expected rates read from a JSON file like
+ *   {
+ *     "lm_queries_per_second": {"baseline": 2.0e7, "tolerance": 0.5}
+ *   }
+ * A measurement passes if it is at least baseline * (1 - tolerance), so
+ * higher is better.  Only this shape of JSON is accepted.
+ */
+class Baseline {
+  public:
+    struct Expected {
+      double baseline;
+      double tolerance;
+    };
+
+    explicit Baseline(const std::string &file);
+
+    // Throws if name is not in the file.
+    const Expected &Find(const std::string &name) const;
+
+    // Print the comparison and return whether measured passes.
+    bool Check(const std::string &name, double measured, std::ostream &to) const;
+
+  private:
+    std::map<std::string, Expected> expected_;
+};
+
+// Write measurements in the format Baseline reads, with tolerance, so a
+// machine can record its own baseline.
+void WriteBaseline(const std::map<std::string, double> &measured, double tolerance, std::ostream &to);
+
+} // namespace perf
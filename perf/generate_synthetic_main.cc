@@ -0,0 +1,87 @@
+// Writes a synthetic phrase table, language model and corpora of chosen size
+// for scaling experiments.  The same options give the same files.
+
+#include "perf/synthetic.hh"
+#include "util/exception.hh"
+#include "util/file.hh"
+#include "util/file_stream.hh"
+
+#include <boost/program_options.hpp>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Write to file, or standard output for "-", and report the size.
+void Output(const std::string &file, const perf::SyntheticConfig &config, void (*write)(const perf::SyntheticConfig &, util::FileStream &)) {
+  if (file.empty()) return;
+  if (file == "-") {
+    util::FileStream out(1);
+    write(config, out);
+    return;
+  }
+  util::scoped_fd fd(util::CreateOrThrow(file.c_str()));
+  {
+    util::FileStream out(fd.get());
+    write(config, out);
+  }
+  std::cerr << "Wrote " << util::SizeOrThrow(fd.get()) << " bytes to " << file << std::endl;
+}
+
+void WriteWeightsOnly(const perf::SyntheticConfig &, util::FileStream &out) {
+  perf::WriteWeights(out);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  try {
+    namespace po = boost::program_options;
+    po::options_description options("Synthetic data options");
+    perf::SyntheticConfig config;
+    std::string phrase_table, arpa, corpus, target_corpus, weights;
+    options.add_options()
+      ("help,h", po::bool_switch(), "Show this help message")
+      ("seed", po::value<uint64_t>(&config.seed)->default_value(config.seed), "Random seed")
+      ("source-vocab", po::value<std::size_t>(&config.source_vocab)->default_value(config.source_vocab), "Source words")
+      ("target-vocab", po::value<std::size_t>(&config.target_vocab)->default_value(config.target_vocab), "Target words")
+      ("multi-word-sources", po::value<std::size_t>(&config.multi_word_sources)->default_value(config.multi_word_sources), "Source phrases of two or more words, in addition to one per source word")
+      ("phrases-per-source", po::value<std::size_t>(&config.phrases_per_source)->default_value(config.phrases_per_source), "Target phrases of each source phrase")
+      ("max-phrase-length", po::value<std::size_t>(&config.max_phrase_length)->default_value(config.max_phrase_length), "Longest source and target phrase")
+      ("ngrams", po::value<std::vector<uint64_t> >(&config.ngrams)->multitoken()->default_value(config.ngrams, "20000 20000"), "N-grams of each order from bigrams up; the number of values sets the order")
+      ("sentences", po::value<std::size_t>(&config.sentences)->default_value(config.sentences), "Sentences in each corpus")
+      ("sentence-length", po::value<std::size_t>(&config.sentence_length)->default_value(config.sentence_length), "Words per sentence")
+      ("zipf", po::value<double>(&config.zipf)->default_value(config.zipf), "Zipf exponent for corpus words and phrases; 0 is uniform")
+      ("phrase-table", po::value<std::string>(&phrase_table), "Write a text phrase table with columns source target dense_features lexical_reordering")
+      ("arpa", po::value<std::string>(&arpa), "Write an ARPA language model over the target words")
+      ("corpus", po::value<std::string>(&corpus), "Write a source corpus to decode")
+      ("target-corpus", po::value<std::string>(&target_corpus), "Write a target corpus for lmplz")
+      ("weights", po::value<std::string>(&weights), "Write decoder weights for the phrase table and language model");
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, options), vm);
+    if (vm["help"].as<bool>() || argc == 1) {
+      std::cerr << "Generates seeded synthetic models and corpora.  Each output is written to a\n"
+        "file or, for -, standard output.  Phrase table rows take about 150 bytes and\n"
+        "ARPA lines about 40, so for example\n"
+        "  --source-vocab 1000000 --multi-word-sources 65000000 --phrases-per-source 10\n"
+        "makes a phrase table of about 100 GB.  Convert with\n"
+        "  binarize_phrase_table -c source target dense_features lexical_reordering\n"
+        "  build_binary\n"
+        << options << std::endl;
+      return 1;
+    }
+    po::notify(vm);
+
+    Output(phrase_table, config, &perf::WritePhraseTable);
+    Output(arpa, config, &perf::WriteARPA);
+    Output(corpus, config, &perf::WriteCorpus);
+    Output(target_corpus, config, &perf::WriteTargetCorpus);
+    Output(weights, config, &WriteWeightsOnly);
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
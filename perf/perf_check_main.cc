@@ -0,0 +1,366 @@
+// Benchmarks on synthetic models, compared against perf/baseline.json.  Run
+// by ctest -L perf.
+
+#include "perf/baseline.hh"
+#include "perf/synthetic.hh"
+#include "lm/model.hh"
+#include "lm/terminal_batch.hh"
+#include "pt/query.hh"
+#include "util/exception.hh"
+#include "util/file.hh"
+#include "util/file_piece.hh"
+#include "util/file_stream.hh"
+#include "util/string_piece.hh"
+#include "util/tokenize_piece.hh"
+#include "util/usage.hh"
+
+#include <boost/program_options.hpp>
+#include <boost/unordered_map.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+namespace perf {
+namespace {
+
+// Each benchmark reports the best of this many runs.
+const unsigned kRuns = 3;
+
+struct Paths {
+  // Directory with decode, lmplz, build_binary and binarize_phrase_table.
+  std::string bin;
+  // Scratch directory for generated files.
+  std::string work;
+
+  std::string Bin(const char *name) const { return bin + '/' + name; }
+  std::string Work(const char *name) const { return work + '/' + name; }
+};
+
+std::string Quote(const std::string &arg) {
+  std::string ret("'");
+  for (std::string::const_iterator i = arg.begin(); i != arg.end(); ++i) {
+    if (*i == '\'') {
+      ret += "'\\''";
+    } else {
+      ret += *i;
+    }
+  }
+  return ret + '\'';
+}
+
+void Run(const std::string &command) {
+  int ret = std::system(command.c_str());
+  UTIL_THROW_IF(ret, util::Exception, "Command failed with status " << ret << ": " << command);
+}
+
+// Best wall time of kRuns runs of command.
+double TimeCommand(const std::string &command) {
+  double best = 0.0;
+  for (unsigned run = 0; run < kRuns; ++run) {
+    double start = util::WallTime();
+    Run(command);
+    double took = util::WallTime() - start;
+    if (!run || took < best) best = took;
+  }
+  return best;
+}
+
+void Generate(const std::string &file, const SyntheticConfig &config, void (*write)(const SyntheticConfig &, util::FileStream &)) {
+  util::scoped_fd fd(util::CreateOrThrow(file.c_str()));
+  util::FileStream out(fd.get());
+  write(config, out);
+}
+
+void WriteWeightsFile(const std::string &file) {
+  util::scoped_fd fd(util::CreateOrThrow(file.c_str()));
+  util::FileStream out(fd.get());
+  WriteWeights(out);
+}
+
+void Binarize(const Paths &paths, const SyntheticConfig &config) {
+  Generate(paths.Work("pt.txt"), config, &WritePhraseTable);
+  Run(Quote(paths.Bin("binarize_phrase_table")) + " -c source target dense_features lexical_reordering <"
+      + Quote(paths.Work("pt.txt")) + " >" + Quote(paths.Work("pt.bin")) + " 2>/dev/null");
+}
+
+void BuildLM(const Paths &paths, const SyntheticConfig &config) {
+  Generate(paths.Work("lm.arpa"), config, &WriteARPA);
+  Run(Quote(paths.Bin("build_binary")) + " " + Quote(paths.Work("lm.arpa")) + " " + Quote(paths.Work("lm.bin")) + " >/dev/null 2>&1");
+}
+
+// Sentences per second, decoding the whole corpus.
+double Decode(const Paths &paths) {
+  SyntheticConfig config;
+  config.sentences = 300;
+  Binarize(paths, config);
+  BuildLM(paths, config);
+  Generate(paths.Work("corpus.txt"), config, &WriteCorpus);
+  WriteWeightsFile(paths.Work("weights"));
+  const std::string command = Quote(paths.Bin("decode"))
+    + " -p " + Quote(paths.Work("pt.bin"))
+    + " -l " + Quote(paths.Work("lm.bin"))
+    + " -W " + Quote(paths.Work("weights"))
+    + " -K 100 -R 4 <" + Quote(paths.Work("corpus.txt")) + " >/dev/null 2>&1";
+  return config.sentences / TimeCommand(command);
+}
+
+// Lookups of every span of the corpus per second.
+double PhraseTableLookup(const Paths &paths) {
+  SyntheticConfig config;
+  config.source_vocab = 5000;
+  config.multi_word_sources = 50000;
+  config.phrases_per_source = 10;
+  config.sentences = 1000;
+  Binarize(paths, config);
+  Generate(paths.Work("corpus.txt"), config, &WriteCorpus);
+
+  pt::Table table(paths.Work("pt.bin").c_str(), util::POPULATE_OR_READ);
+  boost::unordered_map<std::string, pt::WordIndex> vocab;
+  {
+    pt::WordIndex index = 0;
+    pt::VocabRange range(table.Vocab());
+    for (pt::VocabRange::Iterator word = range.begin(); word != range.end(); ++word, ++index) {
+      vocab[word->as_string()] = index;
+    }
+  }
+  std::vector<std::vector<pt::WordIndex> > sentences;
+  util::FilePiece corpus(paths.Work("corpus.txt").c_str());
+  for (StringPiece line; corpus.ReadLineOrEOF(line);) {
+    sentences.resize(sentences.size() + 1);
+    for (util::TokenIter<util::SingleCharacter, true> word(line, ' '); word; ++word) {
+      boost::unordered_map<std::string, pt::WordIndex>::const_iterator found = vocab.find(word->as_string());
+      sentences.back().push_back(found == vocab.end() ? 0 : found->second);
+    }
+  }
+
+  double best = 0.0;
+  uint64_t lookups = 0, rows = 0;
+  for (unsigned run = 0; run < kRuns; ++run) {
+    lookups = 0;
+    double start = util::WallTime();
+    for (std::vector<std::vector<pt::WordIndex> >::const_iterator s = sentences.begin(); s != sentences.end(); ++s) {
+      for (std::size_t begin = 0; begin < s->size(); ++begin) {
+        for (std::size_t end = begin + 1; end <= std::min(s->size(), begin + config.max_phrase_length); ++end) {
+          boost::iterator_range<pt::RowIterator> found(table.Lookup(&(*s)[begin], &(*s)[0] + end));
+          // Walk the rows as the decoder would.
+          for (pt::RowIterator row = found.begin(); row != found.end(); ++row) ++rows;
+          ++lookups;
+        }
+      }
+    }
+    double took = util::WallTime() - start;
+    if (!run || took < best) best = took;
+  }
+  // Keep the walk from being optimized out.
+  if (!rows) std::cerr << "No rows found" << std::endl;
+  return lookups / best;
+}
+
+// FullScore calls per second over a stream of target sentences.
+double LanguageModelQuery(const Paths &paths) {
+  SyntheticConfig config;
+  config.target_vocab = 20000;
+  config.ngrams.assign(3, 300000);
+  config.sentences = 20000;
+  BuildLM(paths, config);
+  Generate(paths.Work("target.txt"), config, &WriteTargetCorpus);
+
+  lm::ngram::ProbingModel model(paths.Work("lm.bin").c_str());
+  std::vector<std::vector<lm::WordIndex> > sentences;
+  util::FilePiece corpus(paths.Work("target.txt").c_str());
+  for (StringPiece line; corpus.ReadLineOrEOF(line);) {
+    sentences.resize(sentences.size() + 1);
+    for (util::TokenIter<util::SingleCharacter, true> word(line, ' '); word; ++word) {
+      sentences.back().push_back(model.GetVocabulary().Index(*word));
+    }
+    sentences.back().push_back(model.GetVocabulary().EndSentence());
+  }
+
+  double best = 0.0;
+  uint64_t queries = 0;
+  float total = 0.0;
+  for (unsigned run = 0; run < kRuns; ++run) {
+    queries = 0;
+    double start = util::WallTime();
+    for (std::vector<std::vector<lm::WordIndex> >::const_iterator s = sentences.begin(); s != sentences.end(); ++s) {
+      lm::ngram::State states[2];
+      states[0] = model.BeginSentenceState();
+      for (std::size_t i = 0; i < s->size(); ++i) {
+        total += model.FullScore(states[i & 1], (*s)[i], states[(i + 1) & 1]).prob;
+      }
+      queries += s->size();
+    }
+    double took = util::WallTime() - start;
+    if (!run || took < best) best = took;
+  }
+  // Keep the queries from being optimized out.
+  if (total == 0.0) std::cerr << "Zero total" << std::endl;
+  return queries / best;
+}
+
+// Target phrases scored per second by TerminalBatch, one span at a time,
+// with a probing model larger than the last level cache.  Reported without
+// and with prefetching groups of words.
+void LanguageModelPhrases(const Paths &paths, std::map<std::string, double> &measured) {
+  SyntheticConfig config;
+  config.source_vocab = 20000;
+  config.multi_word_sources = 20000;
+  config.phrases_per_source = 20;
+  config.target_vocab = 200000;
+  config.ngrams.assign(3, 4000000);
+  Generate(paths.Work("pt.txt"), config, &WritePhraseTable);
+  BuildLM(paths, config);
+
+  lm::ngram::ProbingModel model(paths.Work("lm.bin").c_str());
+  // Target phrases of each span.
+  std::vector<std::vector<std::vector<lm::WordIndex> > > spans;
+  util::FilePiece table(paths.Work("pt.txt").c_str());
+  std::string previous_source;
+  for (StringPiece line; table.ReadLineOrEOF(line);) {
+    util::TokenIter<util::MultiCharacter> column(line, "|||");
+    if (spans.empty() || *column != StringPiece(previous_source)) {
+      previous_source = column->as_string();
+      spans.resize(spans.size() + 1);
+    }
+    ++column;
+    spans.back().resize(spans.back().size() + 1);
+    for (util::TokenIter<util::SingleCharacter, true> word(*column, ' '); word; ++word) {
+      spans.back().back().push_back(model.GetVocabulary().Index(*word));
+    }
+  }
+
+  const std::size_t kGroups[2] = {1, 16};
+  const char *const kNames[2] = {"lm_phrases_per_second", "lm_phrases_prefetch_per_second"};
+  for (unsigned g = 0; g < 2; ++g) {
+    lm::ngram::TerminalBatch<lm::ngram::ProbingModel> batch(model, kGroups[g]);
+    std::vector<lm::ngram::ChartState> states;
+    std::vector<float> scores;
+    double best = 0.0;
+    uint64_t phrases = 0;
+    float total = 0.0;
+    for (unsigned run = 0; run < kRuns; ++run) {
+      phrases = 0;
+      double start = util::WallTime();
+      for (std::size_t s = 0; s < spans.size(); ++s) {
+        for (std::size_t p = 0; p < spans[s].size(); ++p) {
+          batch.Add(&*spans[s][p].begin(), &*spans[s][p].begin() + spans[s][p].size());
+        }
+        states.resize(batch.Size());
+        scores.resize(batch.Size());
+        batch.Finish(&states[0], &scores[0]);
+        total += scores[0];
+        phrases += scores.size();
+      }
+      double took = util::WallTime() - start;
+      if (!run || took < best) best = took;
+    }
+    if (total == 0.0) std::cerr << "Zero total" << std::endl;
+    measured[kNames[g]] = phrases / best;
+  }
+}
+
+// Words of corpus per second estimated by lmplz.
+double EstimateLM(const Paths &paths) {
+  SyntheticConfig config;
+  config.target_vocab = 10000;
+  config.sentences = 20000;
+  Generate(paths.Work("target.txt"), config, &WriteTargetCorpus);
+  const std::string command = Quote(paths.Bin("lmplz")) + " -o 4 -S 20% -T " + Quote(paths.work)
+    + " <" + Quote(paths.Work("target.txt")) + " >" + Quote(paths.Work("estimated.arpa")) + " 2>/dev/null";
+  return config.sentences * config.sentence_length / TimeCommand(command);
+}
+
+struct Benchmark {
+  const char *name;
+  // What the baseline calls the measurement.
+  const char *measure;
+  double (*run)(const Paths &);
+  // Instead of run, for benchmarks that report several measurements.
+  void (*run_several)(const Paths &, std::map<std::string, double> &);
+};
+
+const Benchmark kBenchmarks[] = {
+  {"decode", "decode_sentences_per_second", &Decode, NULL},
+  {"pt_lookup", "pt_lookups_per_second", &PhraseTableLookup, NULL},
+  {"lm_query", "lm_queries_per_second", &LanguageModelQuery, NULL},
+  {"lm_phrases", NULL, NULL, &LanguageModelPhrases},
+  {"lmplz", "lmplz_words_per_second", &EstimateLM, NULL},
+};
+
+void MakeDirectory(const std::string &path) {
+  UTIL_THROW_IF(mkdir(path.c_str(), 0777) && errno != EEXIST, util::ErrnoException, "Could not create " << path);
+}
+
+} // namespace
+} // namespace perf
+
+int main(int argc, char *argv[]) {
+  try {
+    namespace po = boost::program_options;
+    po::options_description options("Performance check options");
+    std::string benchmark, baseline_file, update_file;
+    double update_tolerance;
+    perf::Paths paths;
+    options.add_options()
+      ("help,h", po::bool_switch(), "Show this help message")
+      ("benchmark,b", po::value<std::string>(&benchmark)->default_value("all"), "Benchmark to run: decode, pt_lookup, lm_query, lm_phrases, lmplz or all")
+      ("baseline", po::value<std::string>(&baseline_file), "Baseline JSON to compare against")
+      ("update", po::value<std::string>(&update_file), "Write the measurements to this file as a new baseline")
+      ("update-tolerance", po::value<double>(&update_tolerance)->default_value(0.5), "Tolerance to write with --update")
+      ("bin", po::value<std::string>(&paths.bin)->required(), "Directory with decode, lmplz, build_binary and binarize_phrase_table")
+      ("work", po::value<std::string>(&paths.work)->required(), "Directory for generated models and corpora");
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, options), vm);
+    if (vm["help"].as<bool>()) {
+      std::cerr << "Times decoding, phrase table lookups, language model queries and lmplz on\n"
+        "synthetic data and compares with a baseline.  Exits nonzero if slower.\n"
+        << options << std::endl;
+      return 1;
+    }
+    po::notify(vm);
+
+    perf::MakeDirectory(paths.work);
+    std::map<std::string, double> measured;
+    bool found = false;
+    for (const perf::Benchmark *b = perf::kBenchmarks; b != perf::kBenchmarks + sizeof(perf::kBenchmarks) / sizeof(perf::Benchmark); ++b) {
+      if (benchmark != "all" && benchmark != b->name) continue;
+      found = true;
+      if (b->run) {
+        measured[b->measure] = b->run(paths);
+      } else {
+        b->run_several(paths, measured);
+      }
+    }
+    UTIL_THROW_IF(!found, util::Exception, "Unknown benchmark " << benchmark);
+
+    bool pass = true;
+    if (!baseline_file.empty()) {
+      perf::Baseline baseline(baseline_file);
+      for (std::map<std::string, double>::const_iterator i = measured.begin(); i != measured.end(); ++i) {
+        pass &= baseline.Check(i->first, i->second, std::cout);
+      }
+    } else {
+      for (std::map<std::string, double>::const_iterator i = measured.begin(); i != measured.end(); ++i) {
+        std::cout << i->first << ": " << i->second << std::endl;
+      }
+    }
+    if (!update_file.empty()) {
+      std::ofstream out(update_file.c_str());
+      perf::WriteBaseline(measured, update_tolerance, out);
+      UTIL_THROW_IF(!out, util::ErrnoException, "Could not write " << update_file);
+    }
+    return pass ? 0 : 1;
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return 2;
+  }
+}
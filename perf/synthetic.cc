@@ -0,0 +1,412 @@
+#include "perf/synthetic.hh"
+
+#include "util/exception.hh"
+#include "util/file_stream.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace perf {
+namespace {
+
+// Streams of random numbers, so that changing one part of the config does
+// not change the others.
+enum Stream {
+  kSourceWord, kTargetLength, kTargetWord, kFeature, kNGramWord,
+  kProbability, kBackoff, kSentencePhrase, kCorpusWord, kScramble
+};
+
+// splitmix64 applied to the seed, stream and index.
+uint64_t Random(const SyntheticConfig &config, Stream stream, uint64_t index, uint64_t sub = 0) {
+  uint64_t x = config.seed ^ (static_cast<uint64_t>(stream) << 56) ^ (sub * 0x9E3779B97F4A7C15ULL) ^ (index * 0xBF58476D1CE4E5B9ULL);
+  x += 0x9E3779B97F4A7C15ULL;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+  return x ^ (x >> 31);
+}
+
+// Uniform in [0, 1).
+float Uniform(const SyntheticConfig &config, Stream stream, uint64_t index, uint64_t sub = 0) {
+  return static_cast<float>(Random(config, stream, index, sub) >> 40) / static_cast<float>(1ULL << 24);
+}
+
+// Doubles in [0, 1) from one stream, for sampling that may take several.
+class Draws {
+  public:
+    Draws(const SyntheticConfig &config, Stream stream, uint64_t index)
+      : config_(config), stream_(stream), index_(index), sub_(0) {}
+
+    double operator()() {
+      return static_cast<double>(Random(config_, stream_, index_, sub_++) >> 11) / static_cast<double>(1ULL << 53);
+    }
+
+  private:
+    const SyntheticConfig &config_;
+    const Stream stream_;
+    const uint64_t index_;
+    uint64_t sub_;
+};
+
+uint64_t SaturatingMultiply(uint64_t a, uint64_t b) {
+  return (b && a > std::numeric_limits<uint64_t>::max() / b) ? std::numeric_limits<uint64_t>::max() : a * b;
+}
+
+std::size_t MultiWordLengths(const SyntheticConfig &config) {
+  return config.max_phrase_length > 1 ? config.max_phrase_length - 1 : 0;
+}
+
+std::size_t SourceCount(const SyntheticConfig &config) {
+  return config.source_vocab + (MultiWordLengths(config) ? config.multi_word_sources : 0);
+}
+
+// Words of source phrase index.  The first source_vocab phrases are the
+// words themselves.  Multi-word phrases of each length are numbered and
+// written in base source_vocab.
+void SourcePhrase(const SyntheticConfig &config, uint64_t index, std::vector<uint64_t> &words) {
+  words.clear();
+  if (index < config.source_vocab) {
+    words.push_back(index);
+    return;
+  }
+  index -= config.source_vocab;
+  const std::size_t length = 2 + index % MultiWordLengths(config);
+  uint64_t rank = index / MultiWordLengths(config);
+  // Offset each digit by a hash of the digits before it, which scrambles
+  // the words but can be undone, so phrases stay distinct.
+  uint64_t offset = Random(config, kSourceWord, length);
+  for (std::size_t i = 0; i < length; ++i) {
+    const uint64_t digit = rank % config.source_vocab;
+    words.push_back((digit + offset) % config.source_vocab);
+    offset = Random(config, kSourceWord, offset, digit + 1);
+    rank /= config.source_vocab;
+  }
+}
+
+// Every multi-word phrase of each length must have its own digits.
+void CheckSourceCapacity(const SyntheticConfig &config) {
+  const std::size_t lengths = MultiWordLengths(config);
+  if (!lengths) return;
+  for (std::size_t length = 2; length <= config.max_phrase_length; ++length) {
+    // Indices congruent to length - 2 modulo lengths.
+    const uint64_t wanted = config.multi_word_sources / lengths + (config.multi_word_sources % lengths > length - 2);
+    uint64_t capacity = 1;
+    for (std::size_t i = 0; i < length && capacity < wanted; ++i) {
+      capacity = SaturatingMultiply(capacity, config.source_vocab);
+    }
+    UTIL_THROW_IF(capacity < wanted, util::Exception, "A source vocabulary of " << config.source_vocab << " has too few phrases of length " << length << " for " << config.multi_word_sources << " multi-word sources");
+  }
+}
+
+void WriteSource(const std::vector<uint64_t> &words, util::FileStream &out) {
+  for (std::vector<uint64_t>::const_iterator i = words.begin(); i != words.end(); ++i) {
+    if (i != words.begin()) out << ' ';
+    out << 's' << *i;
+  }
+}
+
+// N-grams are paths in a graph where word w is followed by the words
+// Successor(w, 0), Successor(w, 1), ... and taking successor j costs j.
+// Every prefix and suffix of a path costs at most as much as the path, so
+// taking the paths up to a cost keeps each n-gram's context and suffix in
+// the model, as the probing model expects.  Paths start at <s> (start 0) or
+// a target word (t0 is start 1).
+uint64_t Successor(const SyntheticConfig &config, uint64_t start, uint64_t choice) {
+  return (Random(config, kNGramWord, start) + choice) % config.target_vocab;
+}
+
+uint64_t Starts(const SyntheticConfig &config) {
+  return config.target_vocab + 1;
+}
+
+// n choose k, saturating.
+uint64_t Choose(uint64_t n, uint64_t k) {
+  uint64_t ret = 1;
+  for (uint64_t i = 1; i <= k; ++i) {
+    const uint64_t factor = n - k + i;
+    if (ret > std::numeric_limits<uint64_t>::max() / factor) return std::numeric_limits<uint64_t>::max();
+    // Exact: ret * factor is a multiple of i.
+    ret = ret * factor / i;
+  }
+  return ret;
+}
+
+// Ways to make steps choices costing at most cost.
+uint64_t AtMost(std::size_t steps, int64_t cost) {
+  return cost < 0 ? 0 : Choose(cost + steps, steps);
+}
+
+// Ways to make steps choices costing exactly cost.
+uint64_t Exactly(std::size_t steps, int64_t cost) {
+  if (cost < 0) return 0;
+  if (!steps) return cost == 0;
+  return Choose(cost + steps - 1, steps - 1);
+}
+
+// An order has all paths costing at most base from every start, plus paths
+// costing base + 1 from the first extra_starts starts.
+struct OrderPlan {
+  int64_t base;
+  uint64_t extra_starts;
+  uint64_t count;
+};
+
+std::vector<OrderPlan> PlanNGrams(const SyntheticConfig &config) {
+  std::vector<OrderPlan> plans;
+  const uint64_t starts = Starts(config);
+  for (std::size_t i = 0; i < config.ngrams.size(); ++i) {
+    const std::size_t steps = i + 1;
+    const bool top = (i + 1 == config.ngrams.size());
+    // Costs must stay within those the order below has from every start.
+    const int64_t limit = i ? plans.back().base : static_cast<int64_t>(config.target_vocab) - 1;
+    const uint64_t wanted = config.ngrams[i];
+    OrderPlan plan;
+    // Orders below the top are suffixes of every start, so they have at
+    // least one n-gram from each.
+    plan.base = top ? -1 : 0;
+    while (plan.base < limit && SaturatingMultiply(starts, AtMost(steps, plan.base + 1)) <= wanted) ++plan.base;
+    plan.count = SaturatingMultiply(starts, AtMost(steps, plan.base));
+    plan.extra_starts = 0;
+    if (plan.base < limit && plan.count < wanted) {
+      plan.extra_starts = std::min(starts, (wanted - plan.count) / Exactly(steps, plan.base + 1));
+      plan.count += plan.extra_starts * Exactly(steps, plan.base + 1);
+    }
+    plans.push_back(plan);
+  }
+  return plans;
+}
+
+uint64_t AddMod(uint64_t a, uint64_t b, uint64_t n) {
+  return a >= n - b ? a - (n - b) : a + b;
+}
+
+// a * b % n without overflow, for a, b < n.
+uint64_t MultiplyMod(uint64_t a, uint64_t b, uint64_t n) {
+  if (!(a >> 32) && !(b >> 32)) return a * b % n;
+  uint64_t ret = 0;
+  for (; b; b >>= 1) {
+    if (b & 1) ret = AddMod(ret, a, n);
+    a = AddMod(a, a, n);
+  }
+  return ret;
+}
+
+uint64_t GCD(uint64_t a, uint64_t b) {
+  while (b) {
+    const uint64_t remainder = a % b;
+    a = b;
+    b = remainder;
+  }
+  return a;
+}
+
+// Maps ranks to source phrases by a seeded affine bijection modulo the
+// number of phrases, so the frequent phrases are not just the single words.
+class Scramble {
+  public:
+    Scramble(const SyntheticConfig &config, uint64_t n) : n_(n) {
+      multiplier_ = Random(config, kScramble, n, 0) % n_;
+      while (GCD(multiplier_, n_) != 1) multiplier_ = (multiplier_ + 1) % n_;
+      offset_ = Random(config, kScramble, n, 1) % n_;
+    }
+
+    uint64_t operator()(uint64_t rank) const {
+      return AddMod(MultiplyMod(rank, multiplier_, n_), offset_, n_);
+    }
+
+  private:
+    const uint64_t n_;
+    uint64_t multiplier_, offset_;
+};
+
+void WriteStart(uint64_t start, util::FileStream &out) {
+  if (start) {
+    out << 't' << (start - 1);
+  } else {
+    out << "<s>";
+  }
+}
+
+class NGramWriter {
+  public:
+    NGramWriter(const SyntheticConfig &config, std::size_t order, bool backoff, util::FileStream &out)
+      : config_(config), order_(order), backoff_(backoff), words_(order), out_(out) {}
+
+    // Write the paths from start costing at most budget.
+    void Paths(uint64_t start, int64_t budget) {
+      words_[0] = start;
+      Extend(1, start, budget);
+    }
+
+  private:
+    void Extend(std::size_t position, uint64_t previous, int64_t budget) {
+      if (position == order_) {
+        Write();
+        return;
+      }
+      for (int64_t choice = 0; choice <= budget; ++choice) {
+        // Words after the start are numbered as starts.
+        words_[position] = Successor(config_, previous, choice) + 1;
+        Extend(position + 1, words_[position], budget - choice);
+      }
+    }
+
+    void Write() {
+      uint64_t hash = order_;
+      for (std::size_t i = 0; i < order_; ++i) {
+        hash = Random(config_, kProbability, hash, words_[i]);
+      }
+      out_ << -(0.1f + 2.0f * static_cast<float>(hash >> 40) / static_cast<float>(1ULL << 24)) << '\t';
+      for (std::size_t i = 0; i < order_; ++i) {
+        if (i) out_ << ' ';
+        WriteStart(words_[i], out_);
+      }
+      if (backoff_) out_ << '\t' << -Uniform(config_, kBackoff, hash);
+      out_ << '\n';
+    }
+
+    const SyntheticConfig &config_;
+    const std::size_t order_;
+    const bool backoff_;
+    std::vector<uint64_t> words_;
+    util::FileStream &out_;
+};
+
+// (e^x - 1) / x, continuously.
+double Helper2(double x) {
+  return std::fabs(x) > 1e-8 ? std::expm1(x) / x : 1.0 + x * (0.5 + x / 6.0);
+}
+
+// log(1 + x) / x, continuously.
+double Helper1(double x) {
+  return std::fabs(x) > 1e-8 ? std::log1p(x) / x : 1.0 - x * (0.5 - x / 3.0);
+}
+
+} // namespace
+
+Zipf::Zipf(uint64_t n, double exponent) : n_(static_cast<double>(n)), exponent_(exponent) {
+  UTIL_THROW_IF(!n, util::Exception, "Zipf needs at least one rank");
+  UTIL_THROW_IF(exponent < 0.0, util::Exception, "Zipf exponent " << exponent << " is negative");
+  h_integral_1_ = HIntegral(1.5) - 1.0;
+  h_integral_n_ = HIntegral(n_ + 0.5);
+  s_ = 2.0 - HIntegralInverse(HIntegral(2.5) - H(2.0));
+}
+
+double Zipf::H(double x) const {
+  return std::exp(-exponent_ * std::log(x));
+}
+
+double Zipf::HIntegral(double x) const {
+  const double log_x = std::log(x);
+  return Helper2((1.0 - exponent_) * log_x) * log_x;
+}
+
+double Zipf::HIntegralInverse(double x) const {
+  double t = x * (1.0 - exponent_);
+  if (t < -1.0) t = -1.0;
+  return std::exp(Helper1(t) * x);
+}
+
+void WritePhraseTable(const SyntheticConfig &config, util::FileStream &out) {
+  UTIL_THROW_IF(!config.source_vocab || !config.target_vocab || !config.max_phrase_length, util::Exception, "Vocabularies and phrase length must be positive");
+  CheckSourceCapacity(config);
+  std::vector<uint64_t> source;
+  const std::size_t sources = SourceCount(config);
+  for (std::size_t s = 0; s < sources; ++s) {
+    SourcePhrase(config, s, source);
+    for (std::size_t p = 0; p < config.phrases_per_source; ++p) {
+      const uint64_t row = s * config.phrases_per_source + p;
+      WriteSource(source, out);
+      out << " |||";
+      const std::size_t length = 1 + Random(config, kTargetLength, row) % config.max_phrase_length;
+      for (std::size_t i = 0; i < length; ++i) {
+        out << " t" << (Random(config, kTargetWord, row, i) % config.target_vocab);
+      }
+      out << " |||";
+      for (std::size_t i = 0; i < 4; ++i) {
+        out << ' ' << (0.01f + 0.99f * Uniform(config, kFeature, row, i));
+      }
+      out << " |||";
+      for (std::size_t i = 4; i < 10; ++i) {
+        out << ' ' << (0.05f + 0.95f * Uniform(config, kFeature, row, i));
+      }
+      out << '\n';
+    }
+  }
+}
+
+void WriteARPA(const SyntheticConfig &config, util::FileStream &out) {
+  UTIL_THROW_IF(!config.target_vocab, util::Exception, "Target vocabulary must be positive");
+  const std::vector<OrderPlan> plans(PlanNGrams(config));
+  const std::size_t max_order = plans.size() + 1;
+
+  out << "\\data\\\nngram 1=" << (config.target_vocab + 3) << '\n';
+  for (std::size_t order = 2; order <= max_order; ++order) {
+    out << "ngram " << order << '=' << plans[order - 2].count << '\n';
+  }
+
+  out << "\n\\1-grams:\n";
+  out << "-100\t<unk>\t0\n";
+  out << "-2\t</s>\n";
+  for (uint64_t start = 0; start < Starts(config); ++start) {
+    out << (start ? -(0.5f + 3.0f * Uniform(config, kProbability, start)) : -99.0f) << '\t';
+    WriteStart(start, out);
+    if (max_order > 1) out << '\t' << -Uniform(config, kBackoff, start);
+    out << '\n';
+  }
+  for (std::size_t order = 2; order <= max_order; ++order) {
+    const OrderPlan &plan = plans[order - 2];
+    out << "\n\\" << order << "-grams:\n";
+    NGramWriter writer(config, order, order != max_order, out);
+    for (uint64_t start = 0; start < Starts(config); ++start) {
+      writer.Paths(start, plan.base + (start < plan.extra_starts));
+    }
+  }
+  out << "\n\\end\\\n";
+}
+
+void WriteCorpus(const SyntheticConfig &config, util::FileStream &out) {
+  UTIL_THROW_IF(!config.source_vocab || !config.max_phrase_length, util::Exception, "Source vocabulary and phrase length must be positive");
+  std::vector<uint64_t> phrase;
+  const std::size_t sources = SourceCount(config);
+  const Zipf zipf(sources, config.zipf);
+  const Scramble scramble(config, sources);
+  uint64_t draw = 0;
+  for (std::size_t s = 0; s < config.sentences; ++s) {
+    std::size_t length = 0;
+    while (length < config.sentence_length) {
+      Draws draws(config, kSentencePhrase, draw++);
+      SourcePhrase(config, scramble(zipf.Sample(draws)), phrase);
+      if (length) out << ' ';
+      WriteSource(phrase, out);
+      length += phrase.size();
+    }
+    out << '\n';
+  }
+}
+
+void WriteTargetCorpus(const SyntheticConfig &config, util::FileStream &out) {
+  UTIL_THROW_IF(!config.target_vocab, util::Exception, "Target vocabulary must be positive");
+  const Zipf zipf(config.target_vocab, config.zipf);
+  uint64_t draw = 0;
+  for (std::size_t s = 0; s < config.sentences; ++s) {
+    for (std::size_t i = 0; i < config.sentence_length; ++i) {
+      if (i) out << ' ';
+      Draws draws(config, kCorpusWord, draw++);
+      out << 't' << zipf.Sample(draws);
+    }
+    out << '\n';
+  }
+}
+
+void WriteWeights(util::FileStream &out) {
+  out << "target_word_insertion -0.1\n"
+    "phrase_insertion -0.1\n"
+    "lm 1\n"
+    "lexical_reordering 0.1 0.1 0.1 0.1 0.1 0.1\n"
+    "distortion -0.3\n"
+    "phrase_table 0.2 0.2 0.2 0.2\n"
+    "passthrough -100\n";
+}
+
+} // namespace perf
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include <stdint.h>
+
+namespace util { class FileStream; }
+
+namespace perf {
+
+/* Sizes of a synthetic phrase table, language model and source corpus.
+ * Everything written is a function of the config, so the same config gives
+ * the same files on any machine.  Source words are s0, s1, ... and target
+ * words t0, t1, ...; the language model is over the target words.
+ */
+struct SyntheticConfig {
+  uint64_t seed = 1;
+
+  std::size_t source_vocab = 1000;
+  std::size_t target_vocab = 1000;
+  // Source phrases of two or more words.  Every source word also has
+  // target phrases of its own.
+  std::size_t multi_word_sources = 2000;
+  std::size_t phrases_per_source = 5;
+  // Longest source and target phrase.
+  std::size_t max_phrase_length = 3;
+
+  // Number of n-grams of each order above unigrams: bigrams first.  The
+  // model has close to but no more than this many, except that orders below
+  // the highest have at least one n-gram starting with each word.
+  std::vector<uint64_t> ngrams = {20000, 20000};
+
+  std::size_t sentences = 100;
+  // Source words per sentence, at least.  Sentences are made of whole
+  // source phrases so that longer phrases match.
+  std::size_t sentence_length = 20;
+  // Exponent of Zipf's law for drawing source phrases and target words in
+  // corpora.  0 is uniform.
+  double zipf = 1.0;
+};
+
+/* Draws ranks 0, 1, ..., n - 1 with probability proportional to
+ * (rank + 1)^-exponent in constant memory, so vocabularies can be larger
+ * than a table of cumulative probabilities would allow.  This is
+ * rejection-inversion from Hormann and Derflinger, "Rejection-inversion to
+ * generate variates from monotone discrete distributions" (1996).
+ */
+class Zipf {
+  public:
+    Zipf(uint64_t n, double exponent);
+
+    // uniform() returns doubles in [0, 1).  Most samples take one call.
+    template <class Uniform> uint64_t Sample(Uniform &uniform) const {
+      while (true) {
+        const double u = h_integral_n_ + uniform() * (h_integral_1_ - h_integral_n_);
+        const double x = HIntegralInverse(u);
+        double k = std::floor(x + 0.5);
+        if (k < 1.0) {
+          k = 1.0;
+        } else if (k > n_) {
+          k = n_;
+        }
+        if (k - x <= s_ || u >= HIntegral(k + 0.5) - H(k)) return static_cast<uint64_t>(k) - 1;
+      }
+    }
+
+  private:
+    double H(double x) const;
+    double HIntegral(double x) const;
+    double HIntegralInverse(double x) const;
+
+    const double n_, exponent_;
+    double h_integral_1_, h_integral_n_, s_;
+};
+
+// Columns: source target dense_features (4) lexical_reordering (6).
+void WritePhraseTable(const SyntheticConfig &config, util::FileStream &out);
+
+void WriteARPA(const SyntheticConfig &config, util::FileStream &out);
+
+// Source sentences of phrases drawn by Zipf's law.  Ranks are scrambled so
+// frequent phrases come in every length.
+void WriteCorpus(const SyntheticConfig &config, util::FileStream &out);
+
+// Sentences of sentence_length target words drawn by Zipf's law, for
+// estimating language models.  t0 is the most frequent.
+void WriteTargetCorpus(const SyntheticConfig &config, util::FileStream &out);
+
+// Decoder weights for the features of the phrase table and language model.
+void WriteWeights(util::FileStream &out);
+
+} // namespace perf
@@ -0,0 +1,108 @@
+#define BOOST_TEST_MODULE SyntheticTest
+#include <boost/test/unit_test.hpp>
+
+#include "perf/synthetic.hh"
+#include "lm/model.hh"
+#include "util/file.hh"
+#include "util/file_stream.hh"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace perf { namespace {
+
+class Counter {
+  public:
+    Counter() : draw_(0) {}
+    // Low-discrepancy values in [0, 1) so tests do not depend on a generator.
+    double operator()() {
+      draw_ += 0.6180339887498949;
+      draw_ -= static_cast<double>(static_cast<int>(draw_));
+      return draw_;
+    }
+  private:
+    double draw_;
+};
+
+BOOST_AUTO_TEST_CASE(ZipfFrequencies) {
+  const Zipf zipf(100, 1.0);
+  Counter uniform;
+  std::vector<unsigned> counts(100);
+  const unsigned kSamples = 200000;
+  for (unsigned i = 0; i < kSamples; ++i) {
+    uint64_t rank = zipf.Sample(uniform);
+    BOOST_REQUIRE(rank < 100);
+    ++counts[rank];
+  }
+  // Harmonic number H_100 is about 5.187.
+  BOOST_CHECK_CLOSE(kSamples / 5.187, counts[0], 3.0);
+  BOOST_CHECK_CLOSE(kSamples / 5.187 / 2.0, counts[1], 3.0);
+  BOOST_CHECK_CLOSE(kSamples / 5.187 / 10.0, counts[9], 5.0);
+}
+
+BOOST_AUTO_TEST_CASE(ZipfUniform) {
+  const Zipf zipf(10, 0.0);
+  Counter uniform;
+  std::vector<unsigned> counts(10);
+  for (unsigned i = 0; i < 100000; ++i) {
+    ++counts[zipf.Sample(uniform)];
+  }
+  for (unsigned i = 0; i < 10; ++i) {
+    BOOST_CHECK_CLOSE(10000.0, counts[i], 3.0);
+  }
+}
+
+std::string Write(const SyntheticConfig &config, void (*write)(const SyntheticConfig &, util::FileStream &), util::scoped_fd &file) {
+  file.reset(util::MakeTemp(util::DefaultTempDirectory()));
+  {
+    util::FileStream out(util::DupOrThrow(file.get()));
+    write(config, out);
+  }
+  std::string ret(util::SizeOrThrow(file.get()), 0);
+  util::SeekOrThrow(file.get(), 0);
+  util::ReadOrThrow(file.get(), &ret[0], ret.size());
+  util::SeekOrThrow(file.get(), 0);
+  return ret;
+}
+
+BOOST_AUTO_TEST_CASE(Deterministic) {
+  SyntheticConfig config;
+  config.sentences = 10;
+  util::scoped_fd first, second;
+  BOOST_CHECK(Write(config, &WriteCorpus, first) == Write(config, &WriteCorpus, second));
+  BOOST_CHECK(Write(config, &WriteTargetCorpus, first) == Write(config, &WriteTargetCorpus, second));
+  const std::string table(Write(config, &WritePhraseTable, first));
+  BOOST_CHECK(table == Write(config, &WritePhraseTable, second));
+  config.seed = 2;
+  BOOST_CHECK(table != Write(config, &WritePhraseTable, second));
+}
+
+BOOST_AUTO_TEST_CASE(ARPALoads) {
+  SyntheticConfig config;
+  config.target_vocab = 100;
+  config.ngrams.assign(3, 1000);
+  std::string name(util::DefaultTempDirectory() + "synthetic_test_XXXXXX");
+  util::scoped_fd file(mkstemp(&name[0]));
+  BOOST_REQUIRE(file.get() != -1);
+  {
+    util::FileStream out(file.release());
+    WriteARPA(config, out);
+  }
+  lm::ngram::ProbingModel model(name.c_str());
+  std::remove(name.c_str());
+  BOOST_CHECK_EQUAL(4, model.Order());
+  BOOST_CHECK_EQUAL(103, model.GetVocabulary().Bound());
+}
+
+BOOST_AUTO_TEST_CASE(TooFewSourceWords) {
+  SyntheticConfig config;
+  config.source_vocab = 10;
+  config.multi_word_sources = 1000;
+  config.max_phrase_length = 2;
+  util::scoped_fd file;
+  BOOST_CHECK_THROW(Write(config, &WritePhraseTable, file), util::Exception);
+}
+
+}} // namespaces
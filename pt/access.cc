@@ -2,6 +2,8 @@
 #include "util/exception.hh"
 #include "util/mmap.hh"
 
+#include <cstring>
+
 namespace pt {
 
 namespace {
@@ -10,8 +12,11 @@ enum FieldLabel {
   DenseFeatures = 1,
   SparseFeatures = 2,
   LexicalReordering = 3,
+  WeightsFolded = 4,
+  FoldedDenseWeights = 5,
+  FoldedLexicalReorderingWeights = 6,
   // Leave this last.
-  LastLabel = 4,
+  LastLabel = 7,
 };
 
 void Append(FieldLabel label, std::size_t length, util::scoped_memory &mem) {
@@ -29,6 +34,16 @@ void Append(FieldLabel label, bool include, util::scoped_memory &mem) {
   }
 }
 
+void Append(FieldLabel label, const std::vector<float> &values, util::scoped_memory &mem) {
+  if (values.empty()) return;
+  const std::size_t bytes = values.size() * sizeof(float);
+  HugeRealloc(mem.size() + sizeof(uint32_t) + sizeof(uint64_t) + bytes, false, mem);
+  char *ptr = mem.end() - sizeof(uint32_t) - sizeof(uint64_t) - bytes;
+  *reinterpret_cast<uint32_t*>(ptr) = label;
+  *reinterpret_cast<uint64_t*>(ptr + sizeof(uint32_t)) = values.size();
+  memcpy(ptr + sizeof(uint32_t) + sizeof(uint64_t), &values[0], bytes);
+}
+
 bool ConsumeLabel(FieldLabel label, const char *&ptr, const char *end) {
   if (ptr == end) return false;
   uint32_t value = *reinterpret_cast<const uint32_t*>(ptr);
@@ -54,6 +69,17 @@ void Consume(FieldLabel label, const char *&ptr, const char *end, bool &out) {
   out = ConsumeLabel(label, ptr, end);
 }
 
+void Consume(FieldLabel label, const char *&ptr, const char *end, std::vector<float> &out) {
+  out.clear();
+  if (!ConsumeLabel(label, ptr, end)) return;
+  const uint64_t size = *reinterpret_cast<const uint64_t*>(ptr);
+  ptr += sizeof(uint64_t);
+  UTIL_THROW_IF2((uint64_t)(end - ptr) < size * sizeof(float), "Truncated field " << label);
+  out.resize(size);
+  memcpy(&out[0], ptr, size * sizeof(float));
+  ptr += size * sizeof(float);
+}
+
 } // namespace
 
 void FieldConfig::Save(util::scoped_memory &mem) const {
@@ -61,6 +87,9 @@ void FieldConfig::Save(util::scoped_memory &mem) const {
   Append(DenseFeatures, dense_features, mem);
   Append(SparseFeatures, sparse_features, mem);
   Append(LexicalReordering, lexical_reordering, mem);
+  Append(WeightsFolded, weights_folded, mem);
+  Append(FoldedDenseWeights, folded_dense_weights, mem);
+  Append(FoldedLexicalReorderingWeights, folded_lexical_reordering_weights, mem);
 }
 
 void FieldConfig::Restore(const util::scoped_memory &mem) {
@@ -69,6 +98,9 @@ void FieldConfig::Restore(const util::scoped_memory &mem) {
   Consume(DenseFeatures, ptr, mem.end(), dense_features);
   Consume(SparseFeatures, ptr, mem.end(), sparse_features);
   Consume(LexicalReordering, ptr, mem.end(), lexical_reordering);
+  Consume(WeightsFolded, ptr, mem.end(), weights_folded);
+  Consume(FoldedDenseWeights, ptr, mem.end(), folded_dense_weights);
+  Consume(FoldedLexicalReorderingWeights, ptr, mem.end(), folded_lexical_reordering_weights);
 }
 
 } // namespace pt
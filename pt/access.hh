@@ -6,6 +6,7 @@
 #include <boost/optional.hpp> // Or C++17
 
 #include <limits>
+#include <vector>
 
 namespace util { class scoped_memory; }
 
@@ -23,6 +24,13 @@ class FieldConfig {
     std::size_t dense_features = kNotPresent;
     bool sparse_features = false;
     std::size_t lexical_reordering = kNotPresent;
+    // Feature weights were folded into dense_features (a single weighted sum)
+    // and lexical_reordering (each value weighted) when building.
+    bool weights_folded = false;
+    // The weights that were folded.  Empty for tables built before these
+    // were recorded.
+    std::vector<float> folded_dense_weights;
+    std::vector<float> folded_lexical_reordering_weights;
 
     static bool Present(bool value) { return value; }
     static bool Present(std::size_t value) { return value != kNotPresent; }
@@ -75,7 +83,10 @@ class Access {
       target(layout_, config.target),
       dense_features(layout_, config.dense_features),
       sparse_features(layout_, config.sparse_features),
-      lexical_reordering(layout_, config.lexical_reordering) {}
+      lexical_reordering(layout_, config.lexical_reordering),
+      weights_folded(config.weights_folded),
+      folded_dense_weights(config.folded_dense_weights),
+      folded_lexical_reordering_weights(config.folded_lexical_reordering_weights) {}
 
     OptionalField<util::VectorField<WordIndex, VectorSize> > target;
     OptionalField<util::ArrayField<float> > dense_features;
@@ -83,6 +94,10 @@ class Access {
     OptionalField<util::ArrayField<float> > lexical_reordering;
     // TODO word alignment, properties?
 
+    bool weights_folded;
+    std::vector<float> folded_dense_weights;
+    std::vector<float> folded_lexical_reordering_weights;
+
     // Get the pointer to the next phrase.
     const Row *End(const Row *phrase) const {
       // TODO optimize.
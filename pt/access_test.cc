@@ -15,6 +15,11 @@ void SaveRestore(const FieldConfig config) {
   BOOST_CHECK_EQUAL(config.dense_features, restored.dense_features);
   BOOST_CHECK_EQUAL(config.sparse_features, restored.sparse_features);
   BOOST_CHECK_EQUAL(config.lexical_reordering, restored.lexical_reordering);
+  BOOST_CHECK_EQUAL(config.weights_folded, restored.weights_folded);
+  BOOST_CHECK_EQUAL_COLLECTIONS(config.folded_dense_weights.begin(), config.folded_dense_weights.end(),
+      restored.folded_dense_weights.begin(), restored.folded_dense_weights.end());
+  BOOST_CHECK_EQUAL_COLLECTIONS(config.folded_lexical_reordering_weights.begin(), config.folded_lexical_reordering_weights.end(),
+      restored.folded_lexical_reordering_weights.begin(), restored.folded_lexical_reordering_weights.end());
 }
 
 BOOST_AUTO_TEST_CASE(SaveFieldConfig) {
@@ -29,6 +34,11 @@ BOOST_AUTO_TEST_CASE(SaveFieldConfig) {
   SaveRestore(config);
   config.target = true;
   SaveRestore(config);
+  config.weights_folded = true;
+  config.folded_dense_weights = {0.5, -1.0, 2.0};
+  SaveRestore(config);
+  config.folded_lexical_reordering_weights = {0.25, 0.75};
+  SaveRestore(config);
 }
 
 }} // namespaces
@@ -9,20 +9,6 @@
 #include <string>
 #include <vector>
 
-namespace pt {
-namespace {
-
-template <class Value> bool Bind(const std::string &col, const char *name, std::size_t index, Value &field, std::size_t &out_index) {
-  if (col != name) return false;
-  UTIL_THROW_IF2(FieldConfig::Present(field), "Column " << col << " is already present.");
-  field = 1;
-  out_index = index;
-  return true;
-}
-
-} // namespace
-} // namespace pt
-
 int main(int argc, char *argv[]) {
   try {
     namespace po = boost::program_options;
@@ -42,8 +28,14 @@ int main(int argc, char *argv[]) {
     }
     default_columns_string.resize(default_columns_string.size() - 1);
 
+    pt::RowOrder order;
+    pt::FoldWeights fold;
     options.add_options()
       ("help,h", po::bool_switch(), "Show this help message")
+      ("weights,w", po::value<std::vector<float> >(&order.weights)->multitoken(), "Sort each source phrase's rows by these weights applied to the log dense features, best first")
+      ("limit,k", po::value<std::size_t>(&order.limit)->default_value(0), "Keep at most this many rows for each source phrase (after sorting).  0 keeps all.")
+      ("fold", po::bool_switch(&fold.fold), "Store the dense features as one value weighted by --weights, and lexical reordering values multiplied by --lexro-weights.  The decoder then requires any phrase_table and lexical_reordering weights it is given to match.")
+      ("lexro-weights", po::value<std::vector<float> >(&fold.lexical_reordering)->multitoken(), "Lexical reordering weights to fold")
       ("columns,c", po::value<std::vector<std::string> >()->multitoken()->default_value(default_columns, default_columns_string), "Columns in the text phrase table.  Use `ignore' to skip a column.");
     po::variables_map vm;
     po::store(po::parse_command_line(argc, argv, options), vm);
@@ -66,24 +58,11 @@ int main(int argc, char *argv[]) {
     po::notify(vm);
 
     using namespace pt;
-    bool have_source = false;
     FieldConfig fields;
-    fields.target = false;
     TextColumns columns;
-    std::size_t index = 0;
-    for (const std::string &col : vm["columns"].as<std::vector<std::string> >()) {
-      UTIL_THROW_IF2(
-          col != "ignore"
-          && !Bind(col, "source", index, have_source, columns.source)
-          && !Bind(col, "target", index, fields.target, columns.target)
-          && !Bind(col, "dense_features", index, fields.dense_features, columns.dense_features)
-          && !Bind(col, "sparse_features", index, fields.sparse_features, columns.sparse_features)
-          && !Bind(col, "lexical_reordering", index, fields.lexical_reordering, columns.lexical_reordering),
-        "Bad column name " << col);
-      ++index;
-    }
-    UTIL_THROW_IF2(!have_source, "Source is a required column.");
-    CreateTable(0, 1, columns, fields);
+    BindColumns(vm["columns"].as<std::vector<std::string> >(), columns, fields);
+    fold.dense_features = order.weights;
+    CreateTable(0, 1, columns, fields, order, fold);
   } catch (const std::exception &e) {
     std::cerr << e.what() << std::endl;
     return 1;
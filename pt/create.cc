@@ -30,26 +30,44 @@ void CountColumns(StringPiece part, std::size_t &count) {
 
 class SourceHasher {
   public:
-    explicit SourceHasher(util::GrowableVocab<WordArray> &vocab) : vocab_(vocab) {}
+    explicit SourceHasher(TableWriter &writer) : writer_(writer) {}
 
     uint64_t operator()(StringPiece source) {
+      reuse_.clear();
       for (util::TokenIter<util::BoolCharacter, true> i(source); i; ++i) {
-        reuse_.push_back(vocab_.FindOrInsert(*i));
+        reuse_.push_back(writer_.FindOrInsert(*i));
       }
-      max_source_phrase_length_ = std::max<uint64_t>(max_source_phrase_length_, reuse_.size());
-      uint64_t ret = HashSource(&*reuse_.begin(), &*reuse_.begin() + reuse_.size());
-      reuse_.clear();
-      return ret;
+      return HashSource(&*reuse_.begin(), &*reuse_.begin() + reuse_.size());
     }
 
-    uint64_t MaxSourcePhraseLength() const { return max_source_phrase_length_; }
+    // Length of the last source phrase hashed.
+    std::size_t Length() const { return reuse_.size(); }
 
   private:
-    util::GrowableVocab<WordArray> &vocab_;
+    TableWriter &writer_;
     std::vector<WordIndex> reuse_;
-    uint64_t max_source_phrase_length_ = 0;
 };
 
+template <class Value> bool Bind(const std::string &col, const char *name, std::size_t index, Value &field, std::size_t &out_index) {
+  if (col != name) return false;
+  UTIL_THROW_IF2(FieldConfig::Present(field), "Column " << col << " is already present.");
+  field = 1;
+  out_index = index;
+  return true;
+}
+
+Statistics &AttachStatistics(FileFormat &file) {
+  util::scoped_memory &stats_mem = file.Attach();
+  util::HugeRealloc(sizeof(Statistics), false, stats_mem);
+  return *reinterpret_cast<Statistics*>(stats_mem.get());
+}
+
+util::scoped_memory &AttachConfig(FileFormat &file, const FieldConfig &config) {
+  util::scoped_memory &mem = file.Attach();
+  config.Save(mem);
+  return mem;
+}
+
 void ExtractLine(StringPiece from, std::vector<StringPiece> &out) {
   util::TokenIter<util::MultiCharacter> pipes(from, "|||");
   for (std::vector<StringPiece>::iterator i = out.begin(); i != out.end(); ++i, ++pipes) {
@@ -69,11 +87,9 @@ struct FloatIdentity {
   float operator()(float in) const { return in; }
 };
 
-template <class Transform> void ParseFloats(StringPiece from, OptionalField<util::ArrayField<float> > &field, Row *row, const Transform &op) {
-  if (!field) return;
+template <class Transform> void ParseFloats(StringPiece from, float *to, float *const end, const Transform &op) {
+  const std::size_t size = end - to;
   util::TokenIter<util::BoolCharacter, true> token(from);
-  float *to = field(row).begin();
-  float *const end = field(row).end();
   for (; to != end; ++to, ++token) {
     int processed;
     *to = kConverter.StringToFloat(token->data(), token->size(), &processed);
@@ -82,12 +98,104 @@ template <class Transform> void ParseFloats(StringPiece from, OptionalField<util
     *to = op(*to);
     UTIL_THROW_IF2(processed != token->size(), "Did not process full float for " << *token);
   }
-  UTIL_THROW_IF2(token, "More than " << field(row).size() << " floats in " << from);
+  UTIL_THROW_IF2(token, "More than " << size << " floats in " << from);
+}
+
+template <class Transform> void ParseFloats(StringPiece from, OptionalField<util::ArrayField<float> > &field, Row *row, const Transform &op) {
+  if (!field) return;
+  ParseFloats(from, field(row).begin(), field(row).end(), op);
+}
+
+struct ScoredRow {
+  float score;
+  const char *begin;
+  std::size_t size;
+
+  bool operator<(const ScoredRow &other) const {
+    return score > other.score;
+  }
+};
+
+// Sort and truncate the rows of a source phrase as the order asks.
+void ApplyOrder(const Access &access, const RowOrder &order, TargetBundleWriter &bundle,
+    std::vector<ScoredRow> &rows, std::vector<char> &scratch) {
+  if (order.weights.empty()) {
+    if (!order.limit || bundle.Count() <= order.limit) return;
+    const Row *row = reinterpret_cast<const Row*>(bundle.RowsBegin());
+    for (std::size_t i = 0; i < order.limit; ++i) {
+      row = access.End(row);
+    }
+    bundle.Truncate(const_cast<char*>(reinterpret_cast<const char*>(row)), order.limit);
+    return;
+  }
+  rows.clear();
+  const char *end = bundle.RowsBegin();
+  for (RowCount i = 0; i < bundle.Count(); ++i) {
+    const Row *row = reinterpret_cast<const Row*>(end);
+    end = reinterpret_cast<const char*>(access.End(row));
+    ScoredRow scored;
+    const float *feature = access.dense_features(row).begin();
+    if (access.weights_folded) {
+      scored.score = *feature;
+    } else {
+      scored.score = 0.0;
+      for (std::vector<float>::const_iterator w = order.weights.begin(); w != order.weights.end(); ++w, ++feature) {
+        scored.score += *w * *feature;
+      }
+    }
+    scored.begin = reinterpret_cast<const char*>(row);
+    scored.size = end - scored.begin;
+    rows.push_back(scored);
+  }
+  std::stable_sort(rows.begin(), rows.end());
+  if (order.limit && rows.size() > order.limit) rows.resize(order.limit);
+  scratch.clear();
+  for (std::vector<ScoredRow>::const_iterator i = rows.begin(); i != rows.end(); ++i) {
+    scratch.insert(scratch.end(), i->begin, i->begin + i->size);
+  }
+  std::copy(scratch.begin(), scratch.end(), bundle.RowsBegin());
+  bundle.Truncate(bundle.RowsBegin() + scratch.size(), rows.size());
 }
 
 } // namespace
 
-void CreateTable(int from, int to, const TextColumns columns, FieldConfig &config) {
+void BindColumns(const std::vector<std::string> &names, TextColumns &columns, FieldConfig &fields) {
+  bool have_source = false;
+  fields.target = false;
+  std::size_t index = 0;
+  for (const std::string &col : names) {
+    UTIL_THROW_IF2(
+        col != "ignore"
+        && !Bind(col, "source", index, have_source, columns.source)
+        && !Bind(col, "target", index, fields.target, columns.target)
+        && !Bind(col, "dense_features", index, fields.dense_features, columns.dense_features)
+        && !Bind(col, "sparse_features", index, fields.sparse_features, columns.sparse_features)
+        && !Bind(col, "lexical_reordering", index, fields.lexical_reordering, columns.lexical_reordering),
+      "Bad column name " << col);
+    ++index;
+  }
+  UTIL_THROW_IF2(!have_source, "Source is a required column.");
+}
+
+TableWriter::TableWriter(int to, const FieldConfig &config)
+  : file_(to, kFileHeader, true, util::POPULATE_OR_READ /* does not matter since this is the reading method */),
+    stats_(AttachStatistics(file_)),
+    targets_(file_),
+    config_(AttachConfig(file_, config)),
+    offsets_(file_),
+    vocab_(100, file_),
+    access_(config) {
+  UTIL_THROW_IF2(!access_.target, "Refusing to create a phrase table without target words.");
+}
+
+void TableWriter::Finish() {
+  stats_.max_source_phrase_length = max_source_phrase_length_;
+  stats_.vocab_size = vocab_.Size();
+  vocab_.Action().Finish();
+  file_.Write();
+}
+
+void CreateTable(int from, int to, const TextColumns columns, FieldConfig &config, const RowOrder &order, const FoldWeights &fold) {
   util::FilePiece f(from, NULL, &std::cerr);
   util::LineIterator line = f.begin();
   UTIL_THROW_IF2(!line, "Empty phrase table file");
@@ -115,46 +223,69 @@ void CreateTable(int from, int to, const TextColumns columns, FieldConfig &confi
   CountColumns(dense_features, config.dense_features);
   CountColumns(lexical_reordering, config.lexical_reordering);
   // Now we have a fully-configured set of columns.
+  UTIL_THROW_IF2(!order.weights.empty() && order.weights.size() != config.dense_features,
+      "Sorting by " << order.weights.size() << " weights but the phrase table has " << (FieldConfig::Present(config.dense_features) ? config.dense_features : 0) << " dense features.");
+  // Parsed dense features before folding.
+  std::vector<float> raw_dense;
+  if (fold.fold) {
+    UTIL_THROW_IF2(FieldConfig::Present(config.dense_features) && fold.dense_features.size() != config.dense_features,
+        "Folding " << fold.dense_features.size() << " dense feature weights but the phrase table has " << config.dense_features << " dense features.");
+    UTIL_THROW_IF2(FieldConfig::Present(config.lexical_reordering) && fold.lexical_reordering.size() != config.lexical_reordering,
+        "Folding " << fold.lexical_reordering.size() << " lexical reordering weights but the phrase table has " << config.lexical_reordering << " lexical reordering values.");
+    if (FieldConfig::Present(config.dense_features)) {
+      raw_dense.resize(config.dense_features);
+      config.dense_features = 1;
+    }
+    config.weights_folded = true;
+    config.folded_dense_weights = fold.dense_features;
+    config.folded_lexical_reordering_weights = fold.lexical_reordering;
+  }
 
-  FileFormat file(to, kFileHeader, true, util::POPULATE_OR_READ /* does not matter since this is the reading method */);
-  util::scoped_memory &stats_mem = file.Attach();
-  util::HugeRealloc(sizeof(Statistics), false, stats_mem);
-  Statistics &stats = *reinterpret_cast<Statistics*>(stats_mem.get());
-  TargetWriter target_write(file);
-  config.Save(file.Attach());
-  HashTableRegion<uint64_t> offsets(file);
-  util::GrowableVocab<WordArray> vocab(100, file);
-  SourceHasher source_hasher(vocab);
-  Access access(config);
+  TableWriter writer(to, config);
+  SourceHasher source_hasher(writer);
+  Access &access = writer.Accessor();
 
-  UTIL_THROW_IF2(!access.target, "Refusing to create a phrase table without target words.");
+  std::vector<ScoredRow> order_rows;
+  std::vector<char> order_scratch;
 
   uint64_t source_hash = source_hasher(source), new_source_hash;
   while (line) {
-    offsets.Insert(source_hash, target_write.Offset());
-    TargetBundleWriter bundle(target_write);
+    writer.StartSource(source_hash, source_hasher.Length());
+    TargetBundleWriter bundle(writer.Targets());
     do {
       Row *row = access.Allocate(bundle);
 
       // Fill target.
       util::VectorField<WordIndex, VectorSize>::FakeVector<TargetBundleWriter> vec = access.target(row, bundle);
       for (util::TokenIter<util::BoolCharacter, true> t(target); t; ++t) {
-        vec.push_back(vocab.FindOrInsert(*t));
+        vec.push_back(writer.FindOrInsert(*t));
+      }
+      if (raw_dense.empty()) {
+        ParseFloats(dense_features, access.dense_features, row, TakeLogAndMosesFloor());
+      } else {
+        ParseFloats(dense_features, &raw_dense[0], &raw_dense[0] + raw_dense.size(), TakeLogAndMosesFloor());
+        float &sum = access.dense_features(row)[0];
+        sum = 0.0;
+        for (std::size_t i = 0; i < raw_dense.size(); ++i) {
+          sum += fold.dense_features[i] * raw_dense[i];
+        }
       }
-      ParseFloats(dense_features, access.dense_features, row, TakeLogAndMosesFloor());
       ParseFloats(lexical_reordering, access.lexical_reordering, row, TakeLogAndMosesFloor());
+      if (fold.fold && access.lexical_reordering) {
+        float *value = access.lexical_reordering(row).begin();
+        for (std::size_t i = 0; i < fold.lexical_reordering.size(); ++i, ++value) {
+          *value *= fold.lexical_reordering[i];
+        }
+      }
       // TODO sparse features
  
       if (!++line) break;
       ExtractLine(*line, parsed_line);
     } while ((new_source_hash = source_hasher(source)) == source_hash);
+    ApplyOrder(access, order, bundle, order_rows, order_scratch);
     source_hash = new_source_hash;
   }
-  stats.max_source_phrase_length = source_hasher.MaxSourcePhraseLength();
-  stats.vocab_size = vocab.Size();
-
-  vocab.Action().Finish();
-  file.Write();
+  writer.Finish();
 }
 
 } // namespace pt
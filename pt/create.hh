@@ -1,10 +1,20 @@
 #pragma once
 
+#include "pt/access.hh"
+#include "pt/format.hh"
+#include "pt/hash_table_region.hh"
+#include "pt/record_writer.hh"
+#include "pt/word_array.hh"
+#include "util/mutable_vocab.hh"
+
+#include <algorithm>
 #include <cstddef>
+#include <string>
+#include <vector>
 
 namespace pt {
 
-class FieldConfig;
+struct Statistics;
 
 // Column indices for various fields in text format.
 struct TextColumns {
@@ -14,7 +24,70 @@ struct TextColumns {
   std::size_t lexical_reordering = 4;
 };
 
-// Takes ownership of from and to files.
-void CreateTable(int from, int to, const TextColumns columns, FieldConfig &config);
+// Set columns and fields from column names in the text file.  Names are
+// source, target, dense_features, sparse_features, lexical_reordering, or
+// ignore.  Source is required.
+void BindColumns(const std::vector<std::string> &names, TextColumns &columns, FieldConfig &fields);
+
+// Which rows to keep for each source phrase and in what order.
+struct RowOrder {
+  // If not empty, sort rows by descending dot product of these weights with
+  // the (log) dense features.  Ties keep text file order.
+  std::vector<float> weights;
+  // Keep at most this many rows per source phrase.  0 means all.
+  std::size_t limit = 0;
+};
+
+// Weights applied to the features at build time, for decoding with fixed
+// weights.  The decoder then uses the stored values as they are.
+struct FoldWeights {
+  bool fold = false;
+  // Dense features are replaced by one value: their dot product with these.
+  std::vector<float> dense_features;
+  // Each lexical reordering value is multiplied by its weight.
+  std::vector<float> lexical_reordering;
+};
+
+// Writes the binary format one source phrase at a time:
+//   writer.StartSource(hash, length);
+//   TargetBundleWriter bundle(writer.Targets());
+//   ... allocate rows in bundle ...
+// then writer.Finish() once all source phrases are written.
+class TableWriter {
+  public:
+    // Takes ownership of to.  The config must be complete, i.e. with counts
+    // for any feature columns.
+    TableWriter(int to, const FieldConfig &config);
+
+    WordIndex FindOrInsert(const StringPiece &word) { return vocab_.FindOrInsert(word); }
+
+    // The rows for the source phrase with this hash follow.  Each source
+    // phrase may be started only once.
+    void StartSource(uint64_t hash, std::size_t length) {
+      offsets_.Insert(hash, targets_.Offset());
+      max_source_phrase_length_ = std::max<uint64_t>(max_source_phrase_length_, length);
+    }
+
+    TargetWriter &Targets() { return targets_; }
+
+    Access &Accessor() { return access_; }
+
+    void Finish();
+
+  private:
+    FileFormat file_;
+    Statistics &stats_;
+    TargetWriter targets_;
+    // Regions are attached in construction order.
+    util::scoped_memory &config_;
+    HashTableRegion<uint64_t> offsets_;
+    util::GrowableVocab<WordArray> vocab_;
+    Access access_;
+    uint64_t max_source_phrase_length_ = 0;
+};
+
+// Takes ownership of from and to files.  With fold, rows are sorted by the
+// folded score whenever order has weights.
+void CreateTable(int from, int to, const TextColumns columns, FieldConfig &config, const RowOrder &order = RowOrder(), const FoldWeights &fold = FoldWeights());
 
 } // namespace pt
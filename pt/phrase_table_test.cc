@@ -63,4 +63,77 @@ BOOST_AUTO_TEST_CASE(CreateAndQuery) {
   BOOST_CHECK_CLOSE(std::log(0.25), row.Accessor().dense_features(row)[0], 0.001);
 }
 
+BOOST_AUTO_TEST_CASE(SortAndLimit) {
+  util::scoped_fd binary(util::MakeTemp(util::DefaultTempDirectory()));
+  TextColumns columns;
+  FieldConfig fields;
+  fields.dense_features = 1;
+  RowOrder order;
+  // Prefer the higher second feature: B A before B A C.
+  order.weights = {0.0, 1.0, 0.0, 0.0, 0.0};
+  CreateTable(MakeFile().release(), util::DupOrThrow(binary.get()), columns, fields, order);
+  util::SeekOrThrow(binary.get(), 0);
+  Table table(binary.release(), util::READ);
+
+  WordIndex abc[3] = {3, 4, 5};
+  boost::iterator_range<RowIterator> abc_targets(table.Lookup(abc, abc + 3));
+  BOOST_REQUIRE_EQUAL(2, abc_targets.end() - abc_targets.begin());
+  RowIterator row = abc_targets.begin();
+  BOOST_CHECK_EQUAL(2, row.Accessor().target(row).size());
+  BOOST_CHECK_CLOSE(std::log(0.3), row.Accessor().dense_features(row)[1], 0.001);
+  ++row;
+  BOOST_CHECK_EQUAL(3, row.Accessor().target(row).size());
+  BOOST_CHECK_CLOSE(std::log(0.285714), row.Accessor().dense_features(row)[1], 0.001);
+
+  table.LimitRows(1);
+  abc_targets = table.Lookup(abc, abc + 3);
+  BOOST_REQUIRE_EQUAL(1, abc_targets.end() - abc_targets.begin());
+  BOOST_CHECK_EQUAL(2, abc_targets.begin().Accessor().target(abc_targets.begin()).size());
+}
+
+BOOST_AUTO_TEST_CASE(FoldWeightsIntoScore) {
+  util::scoped_fd binary(util::MakeTemp(util::DefaultTempDirectory()));
+  TextColumns columns;
+  FieldConfig fields;
+  fields.dense_features = 1;
+  RowOrder order;
+  order.weights = {0.0, 1.0, 0.0, 0.0, 2.0};
+  FoldWeights fold;
+  fold.fold = true;
+  fold.dense_features = order.weights;
+  CreateTable(MakeFile().release(), util::DupOrThrow(binary.get()), columns, fields, order, fold);
+  BOOST_CHECK_EQUAL(1, fields.dense_features);
+  util::SeekOrThrow(binary.get(), 0);
+  Table table(binary.release(), util::READ);
+  BOOST_CHECK(table.Accessor().weights_folded);
+  BOOST_CHECK_EQUAL(1, table.Accessor().dense_features.size());
+
+  WordIndex abc[3] = {3, 4, 5};
+  boost::iterator_range<RowIterator> abc_targets(table.Lookup(abc, abc + 3));
+  BOOST_REQUIRE_EQUAL(2, abc_targets.end() - abc_targets.begin());
+  RowIterator row = abc_targets.begin();
+  BOOST_CHECK_EQUAL(2, row.Accessor().target(row).size());
+  BOOST_CHECK_CLOSE(std::log(0.3) + 2.0 * std::log(2.718), row.Accessor().dense_features(row)[0], 0.001);
+  ++row;
+  BOOST_CHECK_CLOSE(std::log(0.285714) + 2.0 * std::log(2.718), row.Accessor().dense_features(row)[0], 0.001);
+}
+
+BOOST_AUTO_TEST_CASE(TruncateInFileOrder) {
+  util::scoped_fd binary(util::MakeTemp(util::DefaultTempDirectory()));
+  TextColumns columns;
+  FieldConfig fields;
+  fields.dense_features = 1;
+  RowOrder order;
+  order.limit = 1;
+  CreateTable(MakeFile().release(), util::DupOrThrow(binary.get()), columns, fields, order);
+  util::SeekOrThrow(binary.get(), 0);
+  Table table(binary.release(), util::READ);
+
+  WordIndex abc[3] = {3, 4, 5};
+  boost::iterator_range<RowIterator> abc_targets(table.Lookup(abc, abc + 3));
+  BOOST_REQUIRE_EQUAL(1, abc_targets.end() - abc_targets.begin());
+  RowIterator row = abc_targets.begin();
+  BOOST_CHECK_EQUAL(3, row.Accessor().target(row).size());
+}
+
 } } // namespaces
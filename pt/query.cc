@@ -2,6 +2,8 @@
 
 #include "util/file.hh"
 
+#include <limits>
+
 namespace pt {
 
 namespace {
@@ -16,8 +18,10 @@ Table::Table(int fd, util::LoadMethod load_method)
   : file_(fd, kFileHeader, false, load_method),
     rows_(file_.Attach()),
     stats_(*reinterpret_cast<const Statistics*>(file_.Attach().get())),
-    access_(LoadFieldConfig(file_)),
-    offsets_(file_) {}
+    config_(LoadFieldConfig(file_)),
+    access_(config_),
+    offsets_(file_),
+    row_limit_(std::numeric_limits<RowCount>::max()) {}
 
 Table::Table(const char *file, util::LoadMethod load_method)
   : Table(util::OpenReadOrThrow(file), load_method) {}
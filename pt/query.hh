@@ -5,6 +5,7 @@
 #include "pt/hash.hh"
 #include "pt/hash_table_region.hh"
 
+#include <algorithm>
 #include <cassert>
 #include <iterator>
 
@@ -81,6 +82,12 @@ class Table {
 
     const Access &Accessor() { return access_; }
 
+    const FieldConfig &Config() const { return config_; }
+
+    // Stop each lookup after this many rows.  Tables binarized with weights
+    // have the best rows first.
+    void LimitRows(RowCount limit) { row_limit_ = limit; }
+
     const Statistics &Stats() const { return stats_; }
 
     VocabRange Vocab() { return file_.Vocab(); }
@@ -91,15 +98,17 @@ class Table {
       if (!offsets_.Find(HashSource(source_begin, source_end), found))
         return RowIterator(nullptr, &access_, 0);
       const char *base = rows_.begin() + *found;
-      RowCount count = *reinterpret_cast<const RowCount*>(base);
+      RowCount count = std::min(*reinterpret_cast<const RowCount*>(base), row_limit_);
       return RowIterator(reinterpret_cast<const Row*>(base + sizeof(RowCount)), &access_, count);
     }
 
     FileFormat file_;
     util::scoped_memory &rows_;
     const Statistics &stats_;
+    FieldConfig config_;
     Access access_;
     HashTableRegion<uint64_t> offsets_;
+    RowCount row_limit_;
 };
 
 } // namespace pt
@@ -77,6 +77,19 @@ class TargetBundleWriter {
       return true;
     }
 
+    // Rows written so far.
+    char *RowsBegin() { return BufferBegin() + sizeof(RowCount); }
+    char *RowsEnd() { return current_; }
+    RowCount Count() const { return count_; }
+
+    // Keep count rows, which now end at end.
+    void Truncate(char *end, RowCount count) {
+      assert(end >= RowsBegin() && end <= current_);
+      assert(count <= count_);
+      current_ = end;
+      count_ = count;
+    }
+
   private:
     void *Increment(std::size_t size) {
       void *ret = current_;
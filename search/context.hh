@@ -18,6 +18,10 @@ class ContextBase {
 
     const Config &GetConfig() const { return config_; }
 
+    void SetLMWeight(Score weight) {
+      config_ = Config(weight, config_.PopLimit(), config_.GetNBest());
+    }
+
   private:
     Config config_;
 };
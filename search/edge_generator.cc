@@ -4,7 +4,9 @@
 #include "lm/model.hh"
 #include "lm/partial.hh"
 #include "search/context.hh"
+#include "search/join_memo.hh"
 #include "search/vertex.hh"
+#include "util/counter.hh"
 
 #include <numeric>
 
@@ -12,19 +14,20 @@ namespace search {
 
 namespace {
 
-template <class Model> void FastScore(const Context<Model> &context, Arity victim, Arity before_idx, Arity incomplete, const PartialVertex &previous_vertex, PartialEdge update) {
-  lm::ngram::ChartState *between = update.Between();
-  lm::ngram::ChartState *before = &between[before_idx], *after = &between[before_idx + 1];
-
+// The language model part of FastScore.  Returns the adjustment and updates
+// before and after.
+template <class Model> float Join(const Context<Model> &context, const PartialVertex &previous_vertex, const PartialVertex &update_nt, lm::ngram::ChartState *before, lm::ngram::ChartState *after, unsigned char &joins) {
   float adjustment = 0.0;
+  joins = 0;
   const lm::ngram::ChartState &previous_reveal = previous_vertex.State();
-  const PartialVertex &update_nt = update.NT()[victim];
   const lm::ngram::ChartState &update_reveal = update_nt.State();
   if ((update_reveal.left.length > previous_reveal.left.length) || (update_reveal.left.full && !previous_reveal.left.full)) {
     adjustment += lm::ngram::RevealAfter(context.LanguageModel(), before->left, before->right, update_reveal.left, previous_reveal.left.length);
+    ++joins;
   }
   if ((update_reveal.right.length > previous_reveal.right.length) || (update_nt.RightFull() && !previous_vertex.RightFull())) {
     adjustment += lm::ngram::RevealBefore(context.LanguageModel(), update_reveal.right, previous_reveal.right.length, update_nt.RightFull(), after->left, after->right);
+    ++joins;
   }
   if (update_nt.Complete()) {
     if (update_reveal.left.full) {
@@ -32,7 +35,50 @@ template <class Model> void FastScore(const Context<Model> &context, Arity victi
     } else {
       assert(update_reveal.left.length == update_reveal.right.length);
       adjustment += lm::ngram::Subsume(context.LanguageModel(), before->left, before->right, after->left, after->right, update_reveal.left.length);
+      ++joins;
     }
+  }
+  return adjustment;
+}
+
+template <class Model> void FastScore(const Context<Model> &context, JoinMemo *memo, Arity victim, Arity before_idx, Arity incomplete, const PartialVertex &previous_vertex, PartialEdge update) {
+  lm::ngram::ChartState *between = update.Between();
+  lm::ngram::ChartState *before = &between[before_idx], *after = &between[before_idx + 1];
+
+  const PartialVertex &update_nt = update.NT()[victim];
+  float adjustment;
+  unsigned char joins;
+  if (!memo) {
+    adjustment = Join(context, previous_vertex, update_nt, before, after, joins);
+  } else if (!memo->Active()) {
+    memo->Bypass();
+    adjustment = Join(context, previous_vertex, update_nt, before, after, joins);
+  } else {
+    JoinMemo::Key key;
+    key.before = *before;
+    key.after = *after;
+    key.update = update_nt.State();
+    key.previous_left_length = previous_vertex.State().left.length;
+    key.previous_right_length = previous_vertex.State().right.length;
+    key.previous_left_full = previous_vertex.State().left.full;
+    key.previous_right_full = previous_vertex.RightFull();
+    key.update_right_full = update_nt.RightFull();
+    key.update_complete = update_nt.Complete();
+    const uint64_t hash = JoinMemo::Hash(key);
+    const JoinMemo::Value *found = memo->Find(key, hash);
+    if (found) {
+      *before = found->before;
+      *after = found->after;
+      adjustment = found->adjustment;
+    } else {
+      JoinMemo::Value value;
+      value.adjustment = adjustment = Join(context, previous_vertex, update_nt, before, after, value.joins);
+      value.before = *before;
+      value.after = *after;
+      memo->Insert(key, hash, value);
+    }
+  }
+  if (update_nt.Complete()) {
     before->right = after->right;
     // Shift the others shifted one down, covering after.  
     for (lm::ngram::ChartState *cover = after; cover < between + incomplete; ++cover) {
@@ -46,6 +92,7 @@ template <class Model> void FastScore(const Context<Model> &context, Arity victi
 
 template <class Model> PartialEdge EdgeGenerator::Pop(const Context<Model> &context) {
   assert(!generate_.empty());
+  UTIL_COUNT("search/pops");
   PartialEdge top = generate_.top();
   generate_.pop();
   PartialVertex *const top_nt = top.NT();
@@ -73,9 +120,11 @@ template <class Model> PartialEdge EdgeGenerator::Pop(const Context<Model> &cont
     incomplete = arity - completed;
   }
 
+  UTIL_COUNT("search/splits");
   PartialVertex old_value(top_nt[victim]);
   PartialVertex alternate_changed;
   if (top_nt[victim].Split(alternate_changed)) {
+    UTIL_COUNT("search/alternates");
     PartialEdge alternate(partial_edge_pool_, arity, incomplete + 1);
     alternate.SetScore(top.GetScore() + alternate_changed.Bound() - old_value.Bound());
 
@@ -96,7 +145,7 @@ template <class Model> PartialEdge EdgeGenerator::Pop(const Context<Model> &cont
   Score before = top.GetScore();
 #endif
   // top is now the continuation.
-  FastScore(context, victim, victim - victim_completed, incomplete, old_value, top);
+  FastScore(context, memo_, victim, victim - victim_completed, incomplete, old_value, top);
   // TODO: dedupe?  
   generate_.push(top);
   assert(lowest_niceness != 254 || top.GetScore() == before);
@@ -15,10 +15,12 @@ class ChartState;
 namespace search {
 
 template <class Model> class Context;
+class JoinMemo;
 
 class EdgeGenerator {
   public:
-    EdgeGenerator() {}
+    // memo, if not NULL, remembers language model joins across calls to Pop.
+    explicit EdgeGenerator(JoinMemo *memo = NULL) : memo_(memo) {}
 
     PartialEdge AllocateEdge(Arity arity) {
       return PartialEdge(partial_edge_pool_, arity);
@@ -35,9 +37,14 @@ class EdgeGenerator {
 
     bool Empty() const { return generate_.empty(); }
 
+    const util::Pool &EdgePool() const { return partial_edge_pool_; }
+
     // Pop.  If there's a complete hypothesis, return it.  Otherwise return an invalid PartialEdge.
     template <class Model> PartialEdge Pop(const Context<Model> &context);
 
+    // Scores in the queue are estimates, not bounds, since language model
+    // context revealed by Pop can raise them.  So the pop limit, not the
+    // score of the best output so far, is what ends the search.
     template <class Model, class Output> void Search(const Context<Model> &context, Output &output) {
       unsigned to_pop = context.PopLimit();
       while (to_pop > 0 && !generate_.empty()) {
@@ -52,6 +59,8 @@ class EdgeGenerator {
     }
 
   private:
+    JoinMemo *memo_;
+
     util::Pool partial_edge_pool_;
 
     typedef std::priority_queue<PartialEdge> Generate;
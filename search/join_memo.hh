@@ -0,0 +1,151 @@
+#ifndef SEARCH_JOIN_MEMO__
+#define SEARCH_JOIN_MEMO__
+
+#include "lm/state.hh"
+#include "util/murmur_hash.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include <stdint.h>
+
+namespace search {
+
+/* Remembers how EdgeGenerator's FastScore joined language model states.
+ * The same hypothesis right state meets the same target phrase left state in
+ * many edges, and the join depends only on the states involved, so it can be
+ * replayed instead of querying the model again.  Entries live in a fixed
+ * number of slots, replacing whatever had the same slot.  Each sentence
+ * samples the hit rate and stops looking things up if it is low.
+ */
+class JoinMemo {
+  public:
+    // Everything FastScore reads.
+    struct Key {
+      lm::ngram::ChartState before, after, update;
+      unsigned char previous_left_length, previous_right_length;
+      bool previous_left_full, previous_right_full;
+      bool update_right_full, update_complete;
+    };
+
+    // Everything FastScore writes, before shifting the states after a
+    // completed non-terminal.
+    struct Value {
+      lm::ngram::ChartState before, after;
+      float adjustment;
+      // Number of RevealAfter, RevealBefore and Subsume calls.
+      unsigned char joins;
+    };
+
+    // Lookups sampled at the start of each sentence and the hit rate needed
+    // to keep using the memo for the rest of it.
+    static const uint64_t kSample = 2048;
+    static const unsigned int kMinHitPercent = 5;
+
+    explicit JoinMemo(std::size_t slots)
+      : slots_(slots), lookups_(0), hits_(0), joins_saved_(0), bypassed_(0), sentence_lookups_(0), sentence_hits_(0), active_(slots != 0) {}
+
+    void NewSentence() {
+      sentence_lookups_ = 0;
+      sentence_hits_ = 0;
+      active_ = !slots_.empty();
+    }
+
+    bool Active() const { return active_; }
+
+    // Call only when Active.  Returns the remembered value or NULL.
+    const Value *Find(const Key &key, uint64_t hash) {
+      ++lookups_;
+      if (++sentence_lookups_ == kSample && sentence_hits_ * 100 < kSample * kMinHitPercent) {
+        active_ = false;
+      }
+      const Slot &slot = slots_[hash % slots_.size()];
+      if (!slot.used || slot.hash != hash || !Equal(slot.key, key)) return NULL;
+      ++hits_;
+      ++sentence_hits_;
+      joins_saved_ += slot.value.joins;
+      return &slot.value;
+    }
+
+    void Insert(const Key &key, uint64_t hash, const Value &value) {
+      Slot &slot = slots_[hash % slots_.size()];
+      slot.used = true;
+      slot.hash = hash;
+      slot.key = key;
+      slot.value = value;
+    }
+
+    // Counted when not Active.
+    void Bypass() { ++bypassed_; }
+
+    // Hashes part of the key; Find compares all of it.
+    static uint64_t Hash(const Key &key) {
+      uint64_t summary[5];
+      summary[0] = Summarize(key.before);
+      summary[1] = Summarize(key.after);
+      summary[2] = Summarize(key.update);
+      summary[3] = hash_value(key.update.right);
+      summary[4] = key.previous_left_length | (key.previous_right_length << 8)
+        | (key.previous_left_full << 16) | (key.previous_right_full << 17)
+        | (key.update_right_full << 18) | (key.update_complete << 19);
+      return util::MurmurHashNative(summary, sizeof(summary));
+    }
+
+    uint64_t Lookups() const { return lookups_; }
+    uint64_t Hits() const { return hits_; }
+    // Language model joins that were replayed instead of computed.
+    uint64_t JoinsSaved() const { return joins_saved_; }
+    // Scores computed without consulting the memo.
+    uint64_t Bypassed() const { return bypassed_; }
+
+    std::size_t MemoryBytes() const { return slots_.capacity() * sizeof(Slot); }
+
+  private:
+    struct Slot {
+      Slot() : used(false) {}
+      bool used;
+      uint64_t hash;
+      Key key;
+      Value value;
+    };
+
+    // Unlike ChartState's operator==, this compares every field the joins read.
+    static bool Equal(const lm::ngram::ChartState &a, const lm::ngram::ChartState &b) {
+      return a.left.length == b.left.length && a.left.full == b.left.full
+        && std::equal(a.left.pointers, a.left.pointers + a.left.length, b.left.pointers)
+        && a.right.length == b.right.length
+        && std::equal(a.right.words, a.right.words + a.right.length, b.right.words)
+        && std::equal(a.right.backoff, a.right.backoff + a.right.length, b.right.backoff);
+    }
+
+    static bool Equal(const Key &a, const Key &b) {
+      return Equal(a.before, b.before) && Equal(a.after, b.after) && Equal(a.update, b.update)
+        && a.previous_left_length == b.previous_left_length
+        && a.previous_right_length == b.previous_right_length
+        && a.previous_left_full == b.previous_left_full
+        && a.previous_right_full == b.previous_right_full
+        && a.update_right_full == b.update_right_full
+        && a.update_complete == b.update_complete;
+    }
+
+    // Lengths, fullness, the last left pointer (which identifies the words
+    // before it) and the last right word.
+    static uint64_t Summarize(const lm::ngram::ChartState &state) {
+      uint64_t ret = state.left.length | (state.left.full << 8) | (state.right.length << 9);
+      if (state.left.length) ret ^= state.left.pointers[state.left.length - 1];
+      if (state.right.length) ret += static_cast<uint64_t>(state.right.words[state.right.length - 1]) << 32;
+      return ret;
+    }
+
+    std::vector<Slot> slots_;
+
+    uint64_t lookups_, hits_, joins_saved_, bypassed_;
+
+    uint64_t sentence_lookups_, sentence_hits_;
+    bool active_;
+};
+
+} // namespace search
+
+#endif // SEARCH_JOIN_MEMO__
@@ -0,0 +1,157 @@
+#include "search/join_memo.hh"
+
+#include "lm/left.hh"
+#include "lm/model.hh"
+#include "lm/partial.hh"
+
+#define BOOST_TEST_MODULE JoinMemoTest
+#include <boost/test/unit_test.hpp>
+
+#include <string.h>
+
+namespace search {
+namespace {
+
+const char *TestLocation() {
+  if (boost::unit_test::framework::master_test_suite().argc < 2) {
+    return "test.arpa";
+  }
+  return boost::unit_test::framework::master_test_suite().argv[1];
+}
+
+lm::ngram::Config SilentConfig() {
+  lm::ngram::Config config;
+  config.arpa_complain = lm::ngram::Config::NONE;
+  config.messages = NULL;
+  return config;
+}
+
+typedef lm::ngram::ProbingModel Model;
+
+lm::ngram::ChartState Phrase(const Model &model, const char *const *words, std::size_t length) {
+  lm::ngram::ChartState ret;
+  memset(&ret, 0, sizeof(ret));
+  lm::ngram::RuleScore<Model> score(model, ret);
+  for (std::size_t i = 0; i < length; ++i) {
+    score.Terminal(model.GetVocabulary().Index(words[i]));
+  }
+  score.Finish();
+  return ret;
+}
+
+// What EdgeGenerator's FastScore does without the memo when an unrevealed
+// non-terminal between before and after is split to update.
+float DirectJoin(const Model &model, const JoinMemo::Key &key, lm::ngram::ChartState &before, lm::ngram::ChartState &after, unsigned char &joins) {
+  float adjustment = 0.0;
+  joins = 0;
+  if (key.update.left.length > key.previous_left_length) {
+    adjustment += lm::ngram::RevealAfter(model, before.left, before.right, key.update.left, key.previous_left_length);
+    ++joins;
+  }
+  if (key.update.right.length > key.previous_right_length) {
+    adjustment += lm::ngram::RevealBefore(model, key.update.right, key.previous_right_length, key.update_right_full, after.left, after.right);
+    ++joins;
+  }
+  return adjustment;
+}
+
+// Every field, unlike ChartState's operator==.
+void CheckEqual(const lm::ngram::ChartState &expected, const lm::ngram::ChartState &actual) {
+  BOOST_CHECK_EQUAL(expected.left.full, actual.left.full);
+  BOOST_REQUIRE_EQUAL(expected.left.length, actual.left.length);
+  BOOST_CHECK_EQUAL_COLLECTIONS(expected.left.pointers, expected.left.pointers + expected.left.length, actual.left.pointers, actual.left.pointers + actual.left.length);
+  BOOST_REQUIRE_EQUAL(expected.right.length, actual.right.length);
+  BOOST_CHECK_EQUAL_COLLECTIONS(expected.right.words, expected.right.words + expected.right.length, actual.right.words, actual.right.words + actual.right.length);
+  BOOST_CHECK_EQUAL_COLLECTIONS(expected.right.backoff, expected.right.backoff + expected.right.length, actual.right.backoff, actual.right.backoff + actual.right.length);
+}
+
+struct ModelFixture {
+  ModelFixture() : m(TestLocation(), SilentConfig()) {
+    // also [would consider] higher
+    const char *also[] = {"also"};
+    const char *would_consider[] = {"would", "consider"};
+    const char *higher[] = {"higher"};
+    memset(&key, 0, sizeof(key));
+    key.before = Phrase(m, also, 1);
+    key.after = Phrase(m, higher, 1);
+    key.update = Phrase(m, would_consider, 2);
+  }
+
+  Model m;
+  JoinMemo::Key key;
+};
+
+BOOST_FIXTURE_TEST_SUITE(suite, ModelFixture)
+
+BOOST_AUTO_TEST_CASE(Replay) {
+  JoinMemo memo(16);
+  BOOST_REQUIRE(memo.Active());
+  const uint64_t hash = JoinMemo::Hash(key);
+  BOOST_CHECK(!memo.Find(key, hash));
+
+  JoinMemo::Value value;
+  value.before = key.before;
+  value.after = key.after;
+  value.adjustment = DirectJoin(m, key, value.before, value.after, value.joins);
+  BOOST_CHECK_EQUAL(2, value.joins);
+  memo.Insert(key, hash, value);
+
+  const JoinMemo::Value *found = memo.Find(key, hash);
+  BOOST_REQUIRE(found);
+  lm::ngram::ChartState before = key.before, after = key.after;
+  unsigned char joins;
+  float adjustment = DirectJoin(m, key, before, after, joins);
+  BOOST_CHECK_EQUAL(adjustment, found->adjustment);
+  CheckEqual(before, found->before);
+  CheckEqual(after, found->after);
+
+  BOOST_CHECK_EQUAL(2U, memo.Lookups());
+  BOOST_CHECK_EQUAL(1U, memo.Hits());
+  BOOST_CHECK_EQUAL(2U, memo.JoinsSaved());
+  BOOST_CHECK_EQUAL(0U, memo.Bypassed());
+}
+
+BOOST_AUTO_TEST_CASE(CollisionMisses) {
+  JoinMemo memo(16);
+  const uint64_t hash = JoinMemo::Hash(key);
+  JoinMemo::Value value;
+  value.before = key.before;
+  value.after = key.after;
+  value.adjustment = DirectJoin(m, key, value.before, value.after, value.joins);
+  memo.Insert(key, hash, value);
+
+  // The hash does not cover backoffs, so this key has the same hash.
+  JoinMemo::Key other(key);
+  BOOST_REQUIRE(other.before.right.length);
+  other.before.right.backoff[0] += 1.0;
+  BOOST_CHECK_EQUAL(hash, JoinMemo::Hash(other));
+  BOOST_CHECK(!memo.Find(other, hash));
+  BOOST_CHECK(memo.Find(key, hash));
+}
+
+BOOST_AUTO_TEST_CASE(Bypass) {
+  JoinMemo off(0);
+  BOOST_CHECK(!off.Active());
+  off.NewSentence();
+  BOOST_CHECK(!off.Active());
+
+  // A sentence that keeps missing stops looking up.
+  JoinMemo memo(16);
+  const uint64_t hash = JoinMemo::Hash(key);
+  const uint64_t sample = JoinMemo::kSample;
+  for (uint64_t i = 0; i < sample; ++i) {
+    BOOST_REQUIRE(memo.Active());
+    BOOST_CHECK(!memo.Find(key, hash));
+  }
+  BOOST_CHECK(!memo.Active());
+  memo.Bypass();
+  BOOST_CHECK_EQUAL(1U, memo.Bypassed());
+  BOOST_CHECK_EQUAL(sample, memo.Lookups());
+  memo.NewSentence();
+  BOOST_CHECK(memo.Active());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace
+} // namespace search
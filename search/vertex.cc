@@ -1,8 +1,7 @@
 #include "search/vertex.hh"
 
 #include "search/context.hh"
-
-#include <boost/unordered_map.hpp>
+#include "util/counter.hh"
 
 #include <algorithm>
 #include <functional>
@@ -45,21 +44,17 @@ class DivideRight {
     unsigned char index_;
 };
 
-template <class Divider> void Split(const Divider &divider, const std::vector<HypoState> &hypos, std::vector<VertexNode> &extend) {
-  // Map from divider to index in extend.
-  typedef boost::unordered_map<uint64_t, std::size_t> Lookup;
-  Lookup lookup;
-  for (std::vector<HypoState>::const_iterator i = hypos.begin(); i != hypos.end(); ++i) {
-    uint64_t key = divider(i->state);
-    std::pair<Lookup::iterator, bool> res(lookup.insert(std::make_pair(key, extend.size())));
-    if (res.second) {
-      extend.resize(extend.size() + 1);
-      extend.back().AppendHypothesis(*i);
-    } else {
-      extend[res.first->second].AppendHypothesis(*i);
-    }
-  }
-  //assert((extend.size() != 1) || (hypos.size() == 1));
+// Open addressing table from divider key to group, used only while splitting.
+struct GroupBucket {
+  uint64_t key;
+  uint32_t group;
+};
+
+const uint32_t kEmptyGroup = static_cast<uint32_t>(-1);
+
+inline std::size_t GroupHash(uint64_t key, unsigned char bits) {
+  // Keys are pointers or word ids, so mix the high bits down.
+  return static_cast<std::size_t>((key * 0x9e3779b97f4a7c15ULL) >> (64 - bits));
 }
 
 lm::WordIndex Identify(const lm::ngram::Right &right, unsigned char index) {
@@ -103,16 +98,24 @@ template <class Side> class DetermineSame {
 } // namespace
 
 namespace {
-struct GreaterByScore : public std::binary_function<const HypoState &, const HypoState &, bool> {
+struct LessByScore : public std::binary_function<const HypoState &, const HypoState &, bool> {
   bool operator()(const HypoState &first, const HypoState &second) const {
-    return first.score > second.score;
+    return first.score < second.score;
   }
 };
+
+struct GreaterByBound : public std::binary_function<const VertexNode &, const VertexNode &, bool> {
+  bool operator()(const VertexNode &first, const VertexNode &second) const {
+    return first.Bound() > second.Bound();
+  }
+};
+
+// Children ordered at a time, at minimum.
+const std::size_t kMinSortBlock = 8;
 } // namespace
 
-void VertexNode::FinishRoot(unsigned char policy) {
-  std::sort(hypos_.begin(), hypos_.end(), GreaterByScore());
-  extend_.clear();
+void VertexNode::FinishRoot(HypoState *begin, HypoState *end, unsigned char policy, util::Pool &pool) {
+  Attach(begin, end, pool);
   // HACK: extend to one hypo so that root can be blank.
   state_.left.full = false;
   state_.left.length = 0;
@@ -120,28 +123,28 @@ void VertexNode::FinishRoot(unsigned char policy) {
   right_full_ = false;
   niceness_ = 0;
   policy_ = policy;
-  if (hypos_.size() == 1) {
-    extend_.resize(1);
-    extend_.front().AppendHypothesis(hypos_.front());
-    extend_.front().FinishedAppending(0, 0, policy);
+  if (end - begin == 1) {
+    VertexNode *child = AllocateExtend(1);
+    child->Attach(begin, end, pool);
+    child->FinishedAppending(0, 0, policy);
   }
-  if (hypos_.empty()) {
+  if (begin == end) {
     bound_ = -INFINITY;
   } else {
-    bound_ = hypos_.front().score;
+    bound_ = std::max_element(begin, end, LessByScore())->score;
   }
 }
 
 void VertexNode::FinishedAppending(const unsigned char common_left, const unsigned char common_right, const unsigned char policy) {
-  assert(!hypos_.empty());
-  assert(extend_.empty());
-  bound_ = hypos_.front().score;
-  state_ = hypos_.front().state;
+  assert(hypos_begin_ != hypos_end_);
+  assert(!extend_size_);
+  bound_ = hypos_begin_->score;
+  state_ = hypos_begin_->state;
   bool all_full = state_.left.full;
   bool all_non_full = !state_.left.full;
   DetermineSame<lm::ngram::Left> left(state_.left, common_left);
   DetermineSame<lm::ngram::Right> right(state_.right, common_right);
-  for (std::vector<HypoState>::const_iterator i = hypos_.begin() + 1; i != hypos_.end(); ++i) {
+  for (const HypoState *i = hypos_begin_ + 1; i != hypos_end_; ++i) {
     all_full &= i->state.left.full;
     all_non_full &= !i->state.left.full;
     left.Consider(i->state.left);
@@ -163,27 +166,115 @@ void VertexNode::FinishedAppending(const unsigned char common_left, const unsign
   }
 }
 
+// Group hypotheses by divider key without allocating per child.  Groups are
+// numbered by first appearance and permuted in place so each is contiguous,
+// then the best hypothesis in each group is swapped to its front.  Scratch
+// space is taken from the pool and returned before the children are allocated.
+template <class Divider> void VertexNode::Split(const Divider &divider) {
+  const std::size_t size = hypos_end_ - hypos_begin_;
+  unsigned char bits = 2;
+  while ((static_cast<std::size_t>(1) << bits) < 2 * size) ++bits;
+  const std::size_t buckets = static_cast<std::size_t>(1) << bits;
+  const std::size_t scratch_size = buckets * sizeof(GroupBucket) + 2 * size * sizeof(uint32_t);
+  void *scratch = pool_->Allocate(scratch_size);
+  GroupBucket *table = static_cast<GroupBucket*>(scratch);
+  // Group of each hypothesis, then its destination index.
+  uint32_t *dest = reinterpret_cast<uint32_t*>(table + buckets);
+  // Size of each group, then its end offset.
+  uint32_t *offsets = dest + size;
+  for (std::size_t b = 0; b < buckets; ++b) table[b].group = kEmptyGroup;
+
+  uint32_t groups = 0;
+  for (std::size_t i = 0; i < size; ++i) {
+    uint64_t key = divider(hypos_begin_[i].state);
+    std::size_t b = GroupHash(key, bits);
+    while (table[b].group != kEmptyGroup && table[b].key != key) {
+      b = (b + 1) & (buckets - 1);
+    }
+    if (table[b].group == kEmptyGroup) {
+      table[b].key = key;
+      table[b].group = groups;
+      offsets[groups++] = 0;
+    }
+    dest[i] = table[b].group;
+    ++offsets[dest[i]];
+  }
+
+  if (groups > 1) {
+    // Exclusive prefix sum gives the start of each group.
+    uint32_t total = 0;
+    for (uint32_t g = 0; g < groups; ++g) {
+      uint32_t count = offsets[g];
+      offsets[g] = total;
+      total += count;
+    }
+    for (std::size_t i = 0; i < size; ++i) {
+      dest[i] = offsets[dest[i]]++;
+    }
+    // Apply the permutation by following cycles.
+    for (std::size_t i = 0; i < size; ++i) {
+      while (dest[i] != i) {
+        std::size_t j = dest[i];
+        std::swap(hypos_begin_[i], hypos_begin_[j]);
+        std::swap(dest[i], dest[j]);
+      }
+    }
+  }
+  //assert((groups != 1) || (size == 1));
+
+  // Release the scratch so the children take its place.
+  pool_->Continue(scratch, -static_cast<std::ptrdiff_t>(scratch_size));
+  VertexNode *child = AllocateExtend(groups);
+  // Groups are contiguous with distinct keys, so boundaries are key changes.
+  HypoState *group_begin = hypos_begin_, *group_best = hypos_begin_;
+  uint64_t group_key = divider(group_begin->state);
+  for (HypoState *i = hypos_begin_ + 1; i != hypos_end_; ++i) {
+    uint64_t key = divider(i->state);
+    if (key != group_key) {
+      std::swap(*group_begin, *group_best);
+      (child++)->Attach(group_begin, i, *pool_);
+      group_begin = i;
+      group_best = i;
+      group_key = key;
+    } else if (i->score > group_best->score) {
+      group_best = i;
+    }
+  }
+  std::swap(*group_begin, *group_best);
+  child->Attach(group_begin, hypos_end_, *pool_);
+  assert(child + 1 == extend_ + extend_size_);
+}
+
 void VertexNode::BuildExtend() {
   // Already built.
-  if (!extend_.empty()) return;
+  if (extend_size_) return;
   // Nothing to build since this is a leaf.
-  if (hypos_.size() <= 1) return;
+  if (hypos_end_ - hypos_begin_ <= 1) return;
+  UTIL_COUNT("search/extends");
   if (policy_ == kPolicyLeft) {
-    Split(DivideLeft(state_.left.length), hypos_, extend_);
+    Split(DivideLeft(state_.left.length));
   } else if (policy_ == kPolicyRight) {
-    Split(DivideRight(state_.right.length), hypos_, extend_);
+    Split(DivideRight(state_.right.length));
   } else {
     assert(policy_ == kPolicyAll);
-    extend_.clear();
-    extend_.resize(hypos_.size());
-    for (std::size_t i = 0; i < hypos_.size(); ++i) {
-      extend_[i].AppendHypothesis(hypos_[i]);
+    VertexNode *child = AllocateExtend(hypos_end_ - hypos_begin_);
+    for (HypoState *i = hypos_begin_; i != hypos_end_; ++i, ++child) {
+      child->Attach(i, i + 1, *pool_);
     }
   }
-  for (std::vector<VertexNode>::iterator i = extend_.begin(); i != extend_.end(); ++i) {
+  for (VertexNode *i = extend_; i != extend_ + extend_size_; ++i) {
     // TODO: provide more here for branching?
     i->FinishedAppending(state_.left.length, state_.right.length, policy_);
   }
 }
 
+void VertexNode::SortExtend(std::size_t index) {
+  assert(index >= extend_sorted_ && index < extend_size_);
+  // Grow geometrically so walking all children costs O(n log n) overall.
+  std::size_t to = std::max(index + 1, extend_sorted_ + std::max(extend_sorted_, kMinSortBlock));
+  to = std::min(to, extend_size_);
+  std::partial_sort(extend_ + extend_sorted_, extend_ + to, extend_ + extend_size_, GreaterByBound());
+  extend_sorted_ = to;
+}
+
 } // namespace search
@@ -3,6 +3,7 @@
 
 #include "lm/left.hh"
 #include "search/types.hh"
+#include "util/pool.hh"
 
 #include <boost/unordered_set.hpp>
 
@@ -32,32 +33,20 @@ const unsigned char kPolicyAll = 3;
 
 class VertexNode {
   public:
-    VertexNode() {}
-
-    void InitRoot() { hypos_.clear(); }
+    VertexNode() : hypos_begin_(NULL), hypos_end_(NULL), extend_(NULL), extend_size_(0), extend_sorted_(0) {}
 
     /* The steps of building a VertexNode:
-     * 1. Default construct.
-     * 2. AppendHypothesis at least once, possibly multiple times.
-     * 3. FinishAppending with the number of words on left and right guaranteed
-     * to be common.
-     * 4. If !Complete(), call BuildExtend to construct the extensions
+     * 1. The Vertex appends hypotheses to its own array.
+     * 2. FinishRoot points the root at the array and finds the bound.
+     * 3. Children are created by BuildExtend as ranges of their parent's
+     * hypotheses, allocated from the Vertex's pool.
+     * Hypotheses are never fully sorted.  Each node keeps its best hypothesis
+     * in front and children are put in descending order of bound only as far
+     * as operator[] has asked for them.
      */
-    // Must default construct, call AppendHypothesis 1 or more times then do FinishedAppending.
-    void AppendHypothesis(const NBestComplete &best) {
-      assert(hypos_.empty() || !(hypos_.front().state == *best.state));
-      HypoState hypo;
-      hypo.history = best.history;
-      hypo.state = *best.state;
-      hypo.score = best.score;
-      hypos_.push_back(hypo);
-    }
-    void AppendHypothesis(const HypoState &hypo) {
-      hypos_.push_back(hypo);
-    }
-
-    // Sort hypotheses for the root.
-    void FinishRoot(const unsigned char policy);
+    // Point the root at [begin, end) and find the bound.  [begin, end) must
+    // outlive the tree.
+    void FinishRoot(HypoState *begin, HypoState *end, const unsigned char policy, util::Pool &pool);
 
     void FinishedAppending(const unsigned char common_left, const unsigned char common_right, const unsigned char policy);
 
@@ -65,12 +54,12 @@ class VertexNode {
 
     // Should only happen to a root node when the entire vertex is empty.   
     bool Empty() const {
-      return hypos_.empty() && extend_.empty();
+      return hypos_begin_ == hypos_end_ && !extend_size_;
     }
 
     bool Complete() const {
       // HACK: prevent root from being complete.  TODO: allow root to be complete.
-      return hypos_.size() == 1 && extend_.empty();
+      return hypos_end_ - hypos_begin_ == 1 && !extend_size_;
     }
 
     const lm::ngram::ChartState &State() const { return state_; }
@@ -85,29 +74,59 @@ class VertexNode {
 
     // Will be invalid unless this is a leaf.   
     Note End() const {
-      assert(hypos_.size() == 1);
-      return hypos_.front().history;
+      assert(hypos_end_ - hypos_begin_ == 1);
+      return hypos_begin_->history;
     }
 
+    // Children in descending order of Bound().  Only the prefix up to index
+    // is guaranteed to be ordered, so a reference stays valid as long as no
+    // lower index was skipped.
     VertexNode &operator[](size_t index) {
-      assert(!extend_.empty());
+      assert(index < extend_size_);
+      if (index >= extend_sorted_) SortExtend(index);
       return extend_[index];
     }
 
     size_t Size() const {
-      return extend_.size();
+      return extend_size_;
     }
 
-	  
-	std::vector<HypoState>& Hypos() {
-		return hypos_;
-	}
-
   private:
-    // Hypotheses to be split.
-    std::vector<HypoState> hypos_;
+    // Point at hypotheses [begin, end) owned by the parent.
+    void Attach(HypoState *begin, HypoState *end, util::Pool &pool) {
+      hypos_begin_ = begin;
+      hypos_end_ = end;
+      extend_ = NULL;
+      extend_size_ = 0;
+      extend_sorted_ = 0;
+      pool_ = &pool;
+    }
+
+    // Allocate children from the pool, uninitialized.
+    VertexNode *AllocateExtend(std::size_t size) {
+      extend_ = static_cast<VertexNode*>(pool_->Allocate(size * sizeof(VertexNode)));
+      extend_size_ = size;
+      extend_sorted_ = 0;
+      return extend_;
+    }
 
-    std::vector<VertexNode> extend_;
+    // Extend the ordered prefix of children to include index.
+    void SortExtend(std::size_t index);
+
+    template <class Divider> void Split(const Divider &divider);
+
+    // Hypotheses to be split.  BuildExtend groups them in place so that each
+    // child is a contiguous subrange.
+    HypoState *hypos_begin_, *hypos_end_;
+
+    // Children, contiguous in pool_.  [extend_, extend_ + extend_sorted_) is in
+    // final order; the rest are ordered lazily.
+    VertexNode *extend_;
+    std::size_t extend_size_;
+    std::size_t extend_sorted_;
+
+    // Owned by the Vertex; backs all children.
+    util::Pool *pool_;
 
     lm::ngram::ChartState state_;
     bool right_full_;
@@ -170,6 +189,45 @@ class Vertex {
   public:
     Vertex() {}
 
+    // Drop all hypotheses and the split tree before appending afresh.
+    void InitRoot() {
+      hypos_.clear();
+      root_ = VertexNode();
+      pool_.FreeAll();
+    }
+
+    void AppendHypothesis(const NBestComplete &best) {
+      assert(hypos_.empty() || !(hypos_.front().state == *best.state));
+      HypoState hypo;
+      hypo.history = best.history;
+      hypo.state = *best.state;
+      hypo.score = best.score;
+      hypos_.push_back(hypo);
+    }
+    void AppendHypothesis(const HypoState &hypo) {
+      hypos_.push_back(hypo);
+    }
+    // Append everything appended to other, in order.
+    void AppendHypotheses(const Vertex &other) {
+      hypos_.insert(hypos_.end(), other.hypos_.begin(), other.hypos_.end());
+    }
+
+    // Drop the split tree but keep the hypotheses so that their scores can
+    // be changed before calling FinishRoot again.
+    std::vector<HypoState> &ReopenRoot() {
+      root_ = VertexNode();
+      pool_.FreeAll();
+      return hypos_;
+    }
+
+    // Point the root at the hypotheses and find its bound; children are
+    // ordered lazily as they are split.  No hypotheses may be appended
+    // afterwards without InitRoot.
+    void FinishRoot(const unsigned char policy) {
+      HypoState *begin = hypos_.empty() ? NULL : &hypos_.front();
+      root_.FinishRoot(begin, begin + hypos_.size(), policy, pool_);
+    }
+
     //PartialVertex RootFirst() const { return PartialVertex(right_); }
     PartialVertex RootAlternate() { return PartialVertex(root_); }
     //PartialVertex RootLast() const { return PartialVertex(left_); }
@@ -198,16 +256,32 @@ class Vertex {
 
     VertexNode &Root() { return root_; }
 
+    // Hypotheses and split tree, not counting the Vertex itself.
+    std::size_t MemoryBytes() const {
+      return hypos_.capacity() * sizeof(HypoState) + pool_.Stats().page_bytes;
+    }
+
   private:
     template <class Output> friend class VertexGenerator;
     template <class Output> friend class RootVertexGenerator;
+
+    // All hypotheses in the vertex.  Nodes of the tree refer to ranges of it.
+    std::vector<HypoState> hypos_;
+
     VertexNode root_;
 
+    // Backs the split tree below root_.
+    util::Pool pool_;
+
     // These will not be set for the root vertex.
     // Branches only on left state.
     //VertexNode left_;
     // Branches only on right state.
     //VertexNode right_;
+
+    // Nodes point into hypos_ and pool_.
+    Vertex(const Vertex &);
+    Vertex &operator=(const Vertex &);
 };
 
 } // namespace search
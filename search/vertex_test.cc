@@ -0,0 +1,198 @@
+#include "search/vertex.hh"
+
+#define BOOST_TEST_MODULE VertexTest
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <vector>
+
+namespace search {
+namespace {
+
+// Split hashes keys by multiplying with this odd constant and keeping the top
+// bits, so keys that differ by its inverse land in the same bucket.
+const uint64_t kHashMultiplier = 0x9e3779b97f4a7c15ULL;
+
+uint64_t Inverse(uint64_t odd) {
+  // Newton's iteration doubles the correct low bits from 3.
+  uint64_t ret = odd;
+  for (unsigned int i = 0; i < 5; ++i) ret *= 2 - odd * ret;
+  return ret;
+}
+
+// Groups come in pairs of keys that collide.
+uint64_t GroupKey(std::size_t group) {
+  return (group / 2) * 0x1000193ULL + 7 + (group % 2) * Inverse(kHashMultiplier);
+}
+
+// Hypothesis id with left state (key, unique) so the root splits by key and
+// each group splits into one leaf per hypothesis.
+HypoState Hypo(uint32_t id, uint64_t key, Score score) {
+  HypoState ret;
+  ret.history.ints.first = id;
+  ret.history.ints.second = 0;
+  ret.state.left.full = false;
+  ret.state.left.length = 2;
+  ret.state.left.pointers[0] = key;
+  ret.state.left.pointers[1] = id + 1;
+  ret.state.right.length = 0;
+  ret.score = score;
+  return ret;
+}
+
+// Groups are interleaved and scores are distinct.
+void MakeHypos(std::size_t count, std::size_t groups, std::vector<HypoState> &out) {
+  out.clear();
+  for (std::size_t i = 0; i < count; ++i) {
+    out.push_back(Hypo(i, GroupKey((i * 13) % groups), -static_cast<Score>((i * 7919) % count) / 8.0));
+  }
+}
+
+void Fill(const std::vector<HypoState> &hypos, Vertex &vertex) {
+  vertex.InitRoot();
+  for (std::size_t i = 0; i < hypos.size(); ++i) {
+    vertex.AppendHypothesis(hypos[i]);
+  }
+  vertex.FinishRoot(kPolicyLeft);
+}
+
+bool LessByScore(const HypoState &first, const HypoState &second) {
+  return first.score < second.score;
+}
+
+struct Group {
+  Group() : best(-INFINITY) {}
+  Score best;
+  std::vector<uint32_t> ids;
+};
+
+typedef std::map<uint64_t, Group> Groups;
+
+void Expect(const std::vector<HypoState> &hypos, Groups &groups) {
+  for (std::size_t i = 0; i < hypos.size(); ++i) {
+    Group &group = groups[hypos[i].state.left.pointers[0]];
+    group.best = std::max(group.best, hypos[i].score);
+    group.ids.push_back(hypos[i].history.ints.first);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(Collide) {
+  const uint64_t inverse = Inverse(kHashMultiplier);
+  BOOST_CHECK_EQUAL(static_cast<uint64_t>(1), inverse * kHashMultiplier);
+  BOOST_CHECK_EQUAL((GroupKey(0) * kHashMultiplier) >> 40, (GroupKey(1) * kHashMultiplier) >> 40);
+}
+
+BOOST_AUTO_TEST_CASE(Contiguous) {
+  std::vector<HypoState> hypos;
+  MakeHypos(200, 30, hypos);
+  Groups groups;
+  Expect(hypos, groups);
+
+  Vertex vertex;
+  Fill(hypos, vertex);
+  vertex.Root().BuildExtend();
+  BOOST_CHECK_EQUAL(groups.size(), vertex.Root().Size());
+
+  // Each key is one run that starts with its best hypothesis.
+  const std::vector<HypoState> &split = vertex.ReopenRoot();
+  BOOST_REQUIRE_EQUAL(hypos.size(), split.size());
+  std::map<uint64_t, std::size_t> runs;
+  for (std::size_t i = 0; i < split.size(); ++i) {
+    uint64_t key = split[i].state.left.pointers[0];
+    if (i && split[i - 1].state.left.pointers[0] == key) continue;
+    ++runs[key];
+    BOOST_CHECK_EQUAL(groups[key].best, split[i].score);
+  }
+  BOOST_CHECK_EQUAL(groups.size(), runs.size());
+  for (std::map<uint64_t, std::size_t>::const_iterator i = runs.begin(); i != runs.end(); ++i) {
+    BOOST_CHECK_EQUAL(1U, i->second);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(Split) {
+  std::vector<HypoState> hypos;
+  MakeHypos(200, 30, hypos);
+  Groups groups;
+  Expect(hypos, groups);
+
+  Vertex vertex;
+  Fill(hypos, vertex);
+  VertexNode &root = vertex.Root();
+  BOOST_CHECK_EQUAL(std::max_element(hypos.begin(), hypos.end(), LessByScore)->score, root.Bound());
+  root.BuildExtend();
+  BOOST_REQUIRE_EQUAL(groups.size(), root.Size());
+
+  Score previous = INFINITY;
+  for (std::size_t i = 0; i < root.Size(); ++i) {
+    VertexNode &child = root[i];
+    BOOST_CHECK(child.Bound() <= previous);
+    previous = child.Bound();
+    Groups::iterator group = groups.find(child.State().left.pointers[0]);
+    BOOST_REQUIRE(group != groups.end());
+    BOOST_CHECK_EQUAL(group->second.best, child.Bound());
+
+    // Leaves are the group's hypotheses, best first.
+    std::vector<uint32_t> ids;
+    child.BuildExtend();
+    if (child.Complete()) {
+      ids.push_back(child.End().ints.first);
+    } else {
+      Score child_previous = child.Bound();
+      for (std::size_t j = 0; j < child.Size(); ++j) {
+        VertexNode &leaf = child[j];
+        BOOST_REQUIRE(leaf.Complete());
+        BOOST_CHECK(leaf.Bound() <= child_previous);
+        child_previous = leaf.Bound();
+        BOOST_CHECK_EQUAL(hypos[leaf.End().ints.first].score, leaf.Bound());
+        ids.push_back(leaf.End().ints.first);
+      }
+      BOOST_CHECK_EQUAL(group->second.best, child[0].Bound());
+    }
+    std::sort(ids.begin(), ids.end());
+    BOOST_CHECK_EQUAL_COLLECTIONS(group->second.ids.begin(), group->second.ids.end(), ids.begin(), ids.end());
+    groups.erase(group);
+  }
+  BOOST_CHECK(groups.empty());
+}
+
+BOOST_AUTO_TEST_CASE(Lazy) {
+  std::vector<HypoState> hypos;
+  // More children than are sorted at once.
+  MakeHypos(300, 100, hypos);
+  Groups groups;
+  Expect(hypos, groups);
+  std::vector<Score> expected;
+  for (Groups::const_iterator i = groups.begin(); i != groups.end(); ++i) {
+    expected.push_back(i->second.best);
+  }
+  std::sort(expected.begin(), expected.end(), std::greater<Score>());
+
+  // In order.
+  Vertex in_order;
+  Fill(hypos, in_order);
+  in_order.Root().BuildExtend();
+  BOOST_REQUIRE_EQUAL(expected.size(), in_order.Root().Size());
+  std::vector<Score> bounds;
+  for (std::size_t i = 0; i < in_order.Root().Size(); ++i) {
+    bounds.push_back(in_order.Root()[i].Bound());
+  }
+  BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(), bounds.begin(), bounds.end());
+
+  // Skipping ahead orders everything before the index too.
+  Vertex skip;
+  Fill(hypos, skip);
+  skip.Root().BuildExtend();
+  BOOST_CHECK_EQUAL(expected[50], skip.Root()[50].Bound());
+  BOOST_CHECK_EQUAL(expected[0], skip.Root()[0].Bound());
+  BOOST_CHECK_EQUAL(expected.back(), skip.Root()[expected.size() - 1].Bound());
+  bounds.clear();
+  for (std::size_t i = 0; i < skip.Root().Size(); ++i) {
+    bounds.push_back(skip.Root()[i].Bound());
+  }
+  BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(), bounds.begin(), bounds.end());
+}
+
+} // namespace
+} // namespace search
@@ -0,0 +1,185 @@
+#include "util/counter.hh"
+
+#include "util/exception.hh"
+#include "util/integer_to_string.hh"
+
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <signal.h>
+#include <unistd.h>
+#endif
+
+namespace util {
+namespace {
+
+const std::size_t kMaxCounters = 128;
+
+// Slots of one thread.  Blocks are never freed: when a thread exits, its
+// counts move to Registry::retired and the block is reused by a new thread.
+struct Block {
+  uint64_t slots[kMaxCounters];
+  bool in_use;
+  // Fixed before the block is published.
+  Block *next;
+};
+
+struct Registry {
+  Registry() : size(0), blocks(NULL) {
+    memset(retired, 0, sizeof(retired));
+  }
+
+  // Held to change anything below.  Names are written before size, so the
+  // signal handler can read them without it.
+  boost::mutex mutex;
+  const char *names[kMaxCounters];
+  volatile std::size_t size;
+  Block *volatile blocks;
+  // Counts of threads that exited.
+  uint64_t retired[kMaxCounters];
+};
+
+// Leaked so counters still work while static objects are destroyed.
+Registry &GetRegistry() {
+  static Registry *registry = new Registry();
+  return *registry;
+}
+
+// Call with the mutex held, except from the signal handler.
+uint64_t Sum(const Registry &registry, std::size_t index) {
+  uint64_t ret = registry.retired[index];
+  for (const Block *block = registry.blocks; block; block = block->next) {
+    ret += block->slots[index];
+  }
+  return ret;
+}
+
+// Run when a thread that counted exits.
+void Retire(Block *block) {
+  Registry &registry = GetRegistry();
+  boost::lock_guard<boost::mutex> lock(registry.mutex);
+  for (std::size_t i = 0; i < kMaxCounters; ++i) {
+    registry.retired[i] += block->slots[i];
+    block->slots[i] = 0;
+  }
+  block->in_use = false;
+  detail::thread_counters = NULL;
+}
+
+boost::thread_specific_ptr<Block> &ThreadBlock() {
+  static boost::thread_specific_ptr<Block> *block = new boost::thread_specific_ptr<Block>(&Retire);
+  return *block;
+}
+
+#ifdef UTIL_COUNTERS
+void PrintAtExit() {
+  PrintCounters(std::cerr);
+}
+#endif
+
+#if !defined(_WIN32) && !defined(_WIN64)
+void WriteAll(const char *data, std::size_t size) {
+  while (size) {
+    ssize_t ret = write(2, data, size);
+    if (ret <= 0) return;
+    data += ret;
+    size -= ret;
+  }
+}
+
+// Only async-signal-safe calls.
+void DumpHandler(int) {
+  const Registry &registry = GetRegistry();
+  const std::size_t size = registry.size;
+  for (std::size_t i = 0; i < size; ++i) {
+    WriteAll(registry.names[i], strlen(registry.names[i]));
+    char buf[ToStringBuf<uint64_t>::kBytes + 2];
+    buf[0] = '\t';
+    char *end = ToString(Sum(registry, i), buf + 1);
+    *end++ = '\n';
+    WriteAll(buf, end - buf);
+  }
+}
+#endif
+
+} // namespace
+
+namespace detail {
+
+UTIL_THREAD_LOCAL uint64_t *thread_counters = NULL;
+
+uint64_t *RegisterCountingThread() {
+  Registry &registry = GetRegistry();
+  Block *block;
+  {
+    boost::lock_guard<boost::mutex> lock(registry.mutex);
+    // Reuse the block of a thread that exited.
+    for (block = registry.blocks; block && block->in_use; block = block->next) {}
+    if (!block) {
+      block = new Block();
+      memset(block->slots, 0, sizeof(block->slots));
+      block->next = registry.blocks;
+      registry.blocks = block;
+    }
+    block->in_use = true;
+  }
+  ThreadBlock().reset(block);
+  return thread_counters = block->slots;
+}
+
+} // namespace detail
+
+Counter::Counter(const char *name) {
+  Registry &registry = GetRegistry();
+  boost::lock_guard<boost::mutex> lock(registry.mutex);
+  const std::size_t size = registry.size;
+  for (index_ = 0; index_ < size; ++index_) {
+    if (!strcmp(registry.names[index_], name)) return;
+  }
+  UTIL_THROW_IF(size == kMaxCounters, Exception, "More than " << kMaxCounters << " counters; raise kMaxCounters in util/counter.cc");
+#ifdef UTIL_COUNTERS
+  if (!size) atexit(&PrintAtExit);
+#endif
+  registry.names[size] = name;
+  registry.size = size + 1;
+}
+
+uint64_t Counter::Total() const {
+  Registry &registry = GetRegistry();
+  boost::lock_guard<boost::mutex> lock(registry.mutex);
+  return Sum(registry, index_);
+}
+
+const char *Counter::Name() const {
+  return GetRegistry().names[index_];
+}
+
+void PrintCounters(std::ostream &to) {
+  Registry &registry = GetRegistry();
+  boost::lock_guard<boost::mutex> lock(registry.mutex);
+  for (std::size_t i = 0; i < registry.size; ++i) {
+    to << registry.names[i] << '\t' << Sum(registry, i) << '\n';
+  }
+  to.flush();
+}
+
+void DumpCountersOnSignal(int signal) {
+#if defined(_WIN32) || defined(_WIN64)
+  UTIL_THROW(Exception, "Dumping counters on a signal is not supported on Windows");
+#else
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = &DumpHandler;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = SA_RESTART;
+  UTIL_THROW_IF(sigaction(signal, &action, NULL), ErrnoException, "Failed to install a handler for signal " << signal);
+#endif
+}
+
+} // namespace util
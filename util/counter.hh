@@ -0,0 +1,77 @@
+#ifndef UTIL_COUNTER_H
+#define UTIL_COUNTER_H
+
+/* Event counters for hot paths, to compare workloads and builds without a
+ * profiler.  Count with
+ *   UTIL_COUNT("search/pops");
+ *   UTIL_COUNT_ADD("search/alternates", pushed);
+ * which compile to nothing unless UTIL_COUNTERS is defined (cmake
+ * -DCOUNTERS=ON).  Each thread adds to its own slots, which are summed when
+ * printing and folded into a total when the thread exits.  When counting,
+ * totals are printed to stderr at exit and by DumpCountersOnSignal.
+ */
+
+#include <cstddef>
+#include <iosfwd>
+
+#include <stdint.h>
+
+#if defined(_MSC_VER)
+#define UTIL_THREAD_LOCAL __declspec(thread)
+#else
+#define UTIL_THREAD_LOCAL __thread
+#endif
+
+namespace util {
+
+namespace detail {
+// This thread's slots, or NULL before it first counts.
+extern UTIL_THREAD_LOCAL uint64_t *thread_counters;
+uint64_t *RegisterCountingThread();
+} // namespace detail
+
+class Counter {
+  public:
+    // Counters with the same name are one counter.  The name must outlive
+    // the program, as a string literal does.
+    explicit Counter(const char *name);
+
+    void Add(uint64_t amount = 1) {
+      uint64_t *slots = detail::thread_counters;
+      if (!slots) slots = detail::RegisterCountingThread();
+      // Only this thread writes the slot; others only read it.
+      slots[index_] += amount;
+    }
+
+    // Sum over all threads, including those that have exited.  Counts still
+    // being made by other threads may or may not be included.
+    uint64_t Total() const;
+
+    const char *Name() const;
+
+  private:
+    std::size_t index_;
+};
+
+// Name and total of every counter, one per line.
+void PrintCounters(std::ostream &to);
+
+// Print counters to stderr whenever the process receives signal, e.g.
+// SIGUSR1.  This does not lock, so a count might be missed while a thread
+// starts or exits.
+void DumpCountersOnSignal(int signal);
+
+} // namespace util
+
+#ifdef UTIL_COUNTERS
+#define UTIL_COUNT_ADD(name, amount) do { \
+  static util::Counter UTIL_COUNTER_this(name); \
+  UTIL_COUNTER_this.Add(amount); \
+} while (0)
+#else
+#define UTIL_COUNT_ADD(name, amount) do {} while (0)
+#endif
+
+#define UTIL_COUNT(name) UTIL_COUNT_ADD(name, 1)
+
+#endif // UTIL_COUNTER_H
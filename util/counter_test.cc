@@ -0,0 +1,50 @@
+#include "util/counter.hh"
+
+#include <boost/thread/thread.hpp>
+
+#include <sstream>
+
+#define BOOST_TEST_MODULE CounterTest
+#include <boost/test/unit_test.hpp>
+
+namespace util { namespace {
+
+void CountTo(Counter *counter, unsigned int times) {
+  for (unsigned int i = 0; i < times; ++i) counter->Add();
+}
+
+BOOST_AUTO_TEST_CASE(SameName) {
+  Counter a("test/same");
+  Counter b("test/same");
+  a.Add(3);
+  b.Add(4);
+  BOOST_CHECK_EQUAL(7, a.Total());
+  BOOST_CHECK_EQUAL(7, b.Total());
+  BOOST_CHECK_EQUAL(std::string("test/same"), a.Name());
+}
+
+BOOST_AUTO_TEST_CASE(Threads) {
+  Counter counter("test/threads");
+  counter.Add(5);
+  // Threads exit before the total is taken, so their counts are retired.
+  boost::thread_group threads;
+  for (unsigned int i = 0; i < 4; ++i) {
+    threads.create_thread(boost::bind(&CountTo, &counter, 1000));
+  }
+  threads.join_all();
+  BOOST_CHECK_EQUAL(4005, counter.Total());
+  // Blocks of exited threads are reused without losing their counts.
+  boost::thread again(boost::bind(&CountTo, &counter, 10));
+  again.join();
+  BOOST_CHECK_EQUAL(4015, counter.Total());
+}
+
+BOOST_AUTO_TEST_CASE(Print) {
+  Counter counter("test/print");
+  counter.Add(42);
+  std::stringstream out;
+  PrintCounters(out);
+  BOOST_CHECK(out.str().find("test/print\t42\n") != std::string::npos);
+}
+
+}} // namespaces
@@ -5,12 +5,17 @@
 #include <cstdlib>
 
 #include <algorithm>
+#include <iomanip>
+#include <iostream>
 
 namespace util {
 
 Pool::Pool() {
   current_ = NULL;
   current_end_ = NULL;
+  retired_used_ = 0;
+  page_bytes_ = 0;
+  high_water_ = 0;
 }
 
 Pool::~Pool() {
@@ -24,15 +29,85 @@ void Pool::FreeAll() {
   free_list_.clear();
   current_ = NULL;
   current_end_ = NULL;
+  retired_used_ = 0;
+  page_bytes_ = 0;
+}
+
+PoolStats Pool::Stats() const {
+  PoolStats ret;
+  ret.pages = free_list_.size();
+  ret.page_bytes = page_bytes_;
+  ret.used_bytes = retired_used_;
+  if (!free_list_.empty()) ret.used_bytes += current_ - static_cast<const uint8_t*>(free_list_.back());
+  ret.high_water = high_water_;
+  return ret;
 }
 
 void *Pool::More(std::size_t size) {
+  // The allocation (or continuation) being made moves to the new page.
+  if (!free_list_.empty()) retired_used_ += (current_ - size) - static_cast<uint8_t*>(free_list_.back());
   std::size_t amount = std::max(static_cast<size_t>(32) << free_list_.size(), size);
   uint8_t *ret = static_cast<uint8_t*>(MallocOrThrow(amount));
   free_list_.push_back(ret);
+  page_bytes_ += amount;
+  high_water_ = std::max(high_water_, page_bytes_);
   current_ = ret + size;
   current_end_ = ret + amount;
   return ret;
 }
 
+void PoolReport::Add(const std::string &name, const PoolStats &stats) {
+  for (std::vector<std::pair<std::string, PoolStats> >::iterator i = entries_.begin(); i != entries_.end(); ++i) {
+    if (i->first == name) {
+      i->second.pages += stats.pages;
+      i->second.page_bytes += stats.page_bytes;
+      i->second.used_bytes += stats.used_bytes;
+      i->second.high_water = std::max(i->second.high_water, stats.high_water);
+      return;
+    }
+  }
+  entries_.push_back(std::make_pair(name, stats));
+}
+
+void PoolReport::AddBytes(const std::string &name, std::size_t bytes) {
+  PoolStats stats;
+  stats.pages = 0;
+  stats.page_bytes = bytes;
+  stats.used_bytes = bytes;
+  stats.high_water = bytes;
+  Add(name, stats);
+}
+
+void PoolReport::Add(const PoolReport &other) {
+  for (std::vector<std::pair<std::string, PoolStats> >::const_iterator i = other.entries_.begin(); i != other.entries_.end(); ++i) {
+    Add(i->first, i->second);
+  }
+}
+
+std::size_t PoolReport::PageBytes() const {
+  std::size_t ret = 0;
+  for (std::vector<std::pair<std::string, PoolStats> >::const_iterator i = entries_.begin(); i != entries_.end(); ++i) {
+    ret += i->second.page_bytes;
+  }
+  return ret;
+}
+
+void PoolReport::Print(std::ostream &to) const {
+  to << std::left << std::setw(32) << "pool" << std::right << std::setw(8) << "pages" << std::setw(14) << "bytes" << std::setw(14) << "used" << std::setw(14) << "high water" << '\n';
+  PoolStats total;
+  total.pages = 0;
+  total.page_bytes = 0;
+  total.used_bytes = 0;
+  total.high_water = 0;
+  for (std::vector<std::pair<std::string, PoolStats> >::const_iterator i = entries_.begin(); i != entries_.end(); ++i) {
+    const PoolStats &s = i->second;
+    to << std::left << std::setw(32) << i->first << std::right << std::setw(8) << s.pages << std::setw(14) << s.page_bytes << std::setw(14) << s.used_bytes << std::setw(14) << s.high_water << '\n';
+    total.pages += s.pages;
+    total.page_bytes += s.page_bytes;
+    total.used_bytes += s.used_bytes;
+    total.high_water += s.high_water;
+  }
+  to << std::left << std::setw(32) << "total" << std::right << std::setw(8) << total.pages << std::setw(14) << total.page_bytes << std::setw(14) << total.used_bytes << std::setw(14) << total.high_water << std::endl;
+}
+
 } // namespace util
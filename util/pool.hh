@@ -3,12 +3,26 @@
 
 #include <cassert>
 #include <cstring>
+#include <iosfwd>
+#include <string>
+#include <utility>
 #include <vector>
 
 #include <stdint.h>
 
 namespace util {
 
+// Memory use of a pool.
+struct PoolStats {
+  std::size_t pages;
+  // Bytes obtained from malloc.
+  std::size_t page_bytes;
+  // Bytes handed out by Allocate and Continue.
+  std::size_t used_bytes;
+  // Most page_bytes held at once.
+  std::size_t high_water;
+};
+
 /* Very simple pool.  It can only allocate memory.  And all of the memory it
  * allocates must be freed at the same time.
  */
@@ -62,6 +76,9 @@ class Pool {
 
     void FreeAll();
 
+    // Counts pages when they are allocated, so Allocate costs nothing more.
+    PoolStats Stats() const;
+
   private:
     void *More(std::size_t size);
 
@@ -69,6 +86,10 @@ class Pool {
 
     uint8_t *current_, *current_end_;
 
+    // Bytes used in pages before the current one.
+    std::size_t retired_used_;
+    std::size_t page_bytes_, high_water_;
+
 #ifdef DEBUG
     // For debugging, check that Continue came from the most recent call.
     void *base_check_;
@@ -106,6 +127,9 @@ class FreePool {
 
     std::size_t ElementSize() const { return element_size_; }
 
+    // Freed elements still count as used.
+    PoolStats Stats() const { return backing_.Stats(); }
+
   private:
     void *free_list_;
 
@@ -114,6 +138,30 @@ class FreePool {
     const std::size_t element_size_;
 };
 
+/* Memory use by name, to tell where memory goes.  Adding a name again sums
+ * pages and bytes and keeps the larger high water, so adding the reports of
+ * several sentences gives totals and the peak of any one sentence.
+ */
+class PoolReport {
+  public:
+    void Add(const std::string &name, const PoolStats &stats);
+
+    void Add(const std::string &name, const Pool &pool) { Add(name, pool.Stats()); }
+
+    // Memory that is not from a util::Pool, such as a boost::object_pool.
+    void AddBytes(const std::string &name, std::size_t bytes);
+
+    void Add(const PoolReport &other);
+
+    std::size_t PageBytes() const;
+
+    // One line per name in the order they were first added, then the total.
+    void Print(std::ostream &to) const;
+
+  private:
+    std::vector<std::pair<std::string, PoolStats> > entries_;
+};
+
 } // namespace util
 
 #endif // UTIL_POOL_H
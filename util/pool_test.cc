@@ -0,0 +1,66 @@
+#include "util/pool.hh"
+
+#include <sstream>
+
+#define BOOST_TEST_MODULE PoolTest
+#include <boost/test/unit_test.hpp>
+
+namespace util { namespace {
+
+BOOST_AUTO_TEST_CASE(Stats) {
+  Pool pool;
+  PoolStats stats = pool.Stats();
+  BOOST_CHECK_EQUAL(0, stats.pages);
+  BOOST_CHECK_EQUAL(0, stats.used_bytes);
+
+  pool.Allocate(10);
+  pool.Allocate(20);
+  stats = pool.Stats();
+  BOOST_CHECK_EQUAL(1, stats.pages);
+  BOOST_CHECK_EQUAL(32, stats.page_bytes);
+  BOOST_CHECK_EQUAL(30, stats.used_bytes);
+
+  // Does not fit, so starts a second page.
+  void *base = pool.Allocate(40);
+  stats = pool.Stats();
+  BOOST_CHECK_EQUAL(2, stats.pages);
+  BOOST_CHECK_EQUAL(32 + 64, stats.page_bytes);
+  BOOST_CHECK_EQUAL(70, stats.used_bytes);
+
+  // Moving to a third page carries the continued allocation along.
+  BOOST_CHECK(pool.Continue(base, 100));
+  stats = pool.Stats();
+  BOOST_CHECK_EQUAL(3, stats.pages);
+  BOOST_CHECK_EQUAL(170, stats.used_bytes);
+  BOOST_CHECK_EQUAL(stats.page_bytes, stats.high_water);
+
+  const std::size_t high_water = stats.high_water;
+  pool.FreeAll();
+  stats = pool.Stats();
+  BOOST_CHECK_EQUAL(0, stats.pages);
+  BOOST_CHECK_EQUAL(0, stats.page_bytes);
+  BOOST_CHECK_EQUAL(0, stats.used_bytes);
+  BOOST_CHECK_EQUAL(high_water, stats.high_water);
+}
+
+BOOST_AUTO_TEST_CASE(Report) {
+  Pool first, second;
+  first.Allocate(16);
+  second.Allocate(100);
+  PoolReport report;
+  report.Add("a", first);
+  report.AddBytes("b", 50);
+  report.Add("a", second);
+  BOOST_CHECK_EQUAL(32 + 100 + 50, report.PageBytes());
+
+  PoolReport sum;
+  sum.Add(report);
+  sum.Add(report);
+  BOOST_CHECK_EQUAL(2 * (32 + 100 + 50), sum.PageBytes());
+
+  std::ostringstream out;
+  sum.Print(out);
+  BOOST_CHECK(out.str().find("total") != std::string::npos);
+}
+
+}} // namespaces
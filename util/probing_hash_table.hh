@@ -143,6 +143,11 @@ template <class EntryT, class HashT, class EqualT = std::equal_to<typename Entry
       return mod_.Ideal(begin_, hash_(key));
     }
 
+    // Start loading the bucket where Find(key) begins.
+    void Prefetch(const Key key) const {
+      UTIL_PREFETCH(Ideal(key));
+    }
+
     template <class T> MutableIterator Insert(const T &t) {
 #ifdef DEBUG
       assert(initialized_);